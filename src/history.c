@@ -1,11 +1,25 @@
 #include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "history.h"
 #include "matrix.h"
 #include "network.h"
 
+// a frame is the front of network->buffer holding the original and
+// gradient weights followed by the original and gradient biases
+integer_t history_frame_length(struct network_t *network) {
+	integer_t length = 0;
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		struct matrix_t *biases = network->biases[NETWORK_ORIGINAL] + i;
+		length += 2 * weights->rows * weights->cols + 2 * biases->cols;
+	}
+
+	return length;
+}
+
 struct history_t history_new(char const *path, int flags) {
 	struct history_t self;
 
@@ -28,23 +42,80 @@ void history_write_cfg(struct history_t *history, struct network_t *network) {
 
 		integer_t layer_neuron_count = layer->cols;
 		write(history->file, &layer_neuron_count, sizeof(integer_t));
-
-		if (i + 1 == history->layer_count) continue;
-		integer_t next_layer_neuron_count = (layer + 1)->cols;
-		history->neuron_count += 
-			2 * layer_neuron_count * next_layer_neuron_count +
-			4 * layer_neuron_count;
 	}
 
+	integer_t layout = network->layout;
+	write(history->file, &layout, sizeof(integer_t));
+
+	history->neuron_count = history_frame_length(network);
+
 	fsync(history->file);
 }
 
 void history_write_frame(struct history_t *history, struct network_t *network) {
-	for (int i = 0; i < history->neuron_count; i++) {
-		decimal_t value = network->buffer[i];
-		write(history->file, &value, sizeof(decimal_t));
-	}
+	assert(network->mapping == NULL);
+
+	write(history->file, network->buffer, history->neuron_count * sizeof(decimal_t));
 	fsync(history->file);
+
+	history->size += 1;
+}
+
+void history_resume(struct history_t *history, struct network_t *network, integer_t frame_count) {
+	struct network_t recorded = history_read_cfg(history);
+
+	assert(recorded.layer_count == network->layer_count);
+	assert(recorded.layout == network->layout);
+	for (int i = 0; i < network->layer_count; i++) {
+		integer_t recorded_count = recorded.activations[NETWORK_ORIGINAL][i].cols;
+		assert(recorded_count == network->activations[NETWORK_ORIGINAL][i].cols);
+	}
+	network_free(&recorded);
+
+	off_t cfg_size = lseek(history->file, 0, SEEK_CUR);
+	off_t size = cfg_size + (off_t) frame_count * history->neuron_count * sizeof(decimal_t);
+
+	struct stat status;
+	int result = fstat(history->file, &status);
+	assert(result != -1);
+	assert(status.st_size >= size);
+
+	result = ftruncate(history->file, size);
+	assert(result != -1);
+	off_t offset = lseek(history->file, size, SEEK_SET);
+	assert(offset == size);
+
+	history->size = frame_count;
+}
+
+struct network_t history_read_cfg(struct history_t *history) {
+	ssize_t length = read(history->file, &history->layer_count, sizeof(integer_t));
+	assert(length == sizeof(integer_t));
+	assert(history->layer_count > 1);
+
+	integer_t neuron_counts[history->layer_count];
+	length = read(history->file, neuron_counts, sizeof(neuron_counts));
+	assert(length == sizeof(neuron_counts));
+
+	integer_t layout;
+	length = read(history->file, &layout, sizeof(integer_t));
+	assert(length == sizeof(integer_t));
+
+	struct network_t network = network_from(history->layer_count, neuron_counts);
+	network_set_layout(&network, layout);
+	history->neuron_count = history_frame_length(&network);
+
+	return network;
+}
+
+bool history_read_frame(struct history_t *history, struct network_t *network) {
+	ssize_t size = history->neuron_count * sizeof(decimal_t);
+	ssize_t length = read(history->file, network->buffer, size);
+	if (length != size) return false;
+
+	history->size += 1;
+
+	return true;
 }
 
 void history_close(struct history_t *history) {
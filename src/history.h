@@ -1,6 +1,8 @@
 #ifndef HISTORY_H
 #define HISTORY_H
 
+#include <stdbool.h>
+
 #include "network.h"
 #include "matrix.h"
 
@@ -9,16 +11,27 @@
 
 struct history_t {
 	int file;
+	// frames written or read so far
 	integer_t size;
 	integer_t layer_count;
+	// length of a single frame in numbers
 	integer_t neuron_count;
 };
 
 struct history_t history_new(char const *path, int flags);
 
+integer_t history_frame_length(struct network_t *network);
+
 void history_write_cfg(struct history_t *history, struct network_t *network);
 void history_write_frame(struct history_t *history, struct network_t *network);
 
+// reopens a recording for writing after `frame_count` frames, frames past
+// those are dropped, the recording has to match the network
+void history_resume(struct history_t *history, struct network_t *network, integer_t frame_count);
+
+struct network_t history_read_cfg(struct history_t *history);
+bool history_read_frame(struct history_t *history, struct network_t *network);
+
 void history_close(struct history_t *history);
 
 #endif // !HISTORY_H
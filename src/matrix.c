@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include "matrix.h"
+#include "random.h"
 
 struct matrix_t matrix_new(integer_t cols, integer_t rows) {
 	struct matrix_t self;
@@ -56,16 +57,40 @@ void matrix_mul(
 	assert(product->rows == a->rows);
 	assert(product->cols == b->cols);
 
-	integer_t length = product->rows * product->cols;
-	for (int i = 0; i < length; i++) {
-		integer_t col = i % product->cols;
-		integer_t row = i / product->cols;
+	for (int row = 0; row < product->rows; row++) {
+		for (int col = 0; col < product->cols; col++) {
+			MATRIX_AT(*product, col, row) = 0;
+		}
 
-		MATRIX_AT(*product, col, row) = 0;
+		// add up whole rows of b so both b and product are read in order,
+		// each product entry still sums over k in ascending order
 		for (size_t k = 0; k < a->cols; k++) {
-			MATRIX_AT(*product, col, row) +=
-				MATRIX_AT(*a, k, row) *
-				MATRIX_AT(*b, col, k);
+			decimal_t value = MATRIX_AT(*a, k, row);
+
+			for (int col = 0; col < product->cols; col++) {
+				MATRIX_AT(*product, col, row) += value * MATRIX_AT(*b, col, k);
+			}
+		}
+	}
+}
+
+void matrix_mul_transposed(
+	struct matrix_t *product,
+	struct matrix_t *const a,
+	struct matrix_t *const b
+) {
+	assert(a->cols == b->cols);
+	assert(product->rows == a->rows);
+	assert(product->cols == b->rows);
+
+	for (int row = 0; row < product->rows; row++) {
+		for (int col = 0; col < product->cols; col++) {
+			decimal_t sum = 0;
+			for (size_t k = 0; k < a->cols; k++) {
+				sum += MATRIX_AT(*a, k, row) * MATRIX_AT(*b, k, col);
+			}
+
+			MATRIX_AT(*product, col, row) = sum;
 		}
 	}
 }
@@ -87,10 +112,8 @@ void matrix_print(struct matrix_t *matrix) {
 	}
 }
 
-void matrix_rand(struct matrix_t *dst) {
+void matrix_rand(struct matrix_t *dst, struct random_t *random, decimal_t low, decimal_t high) {
 	for (int i = 0; i < dst->rows; i++) {
-		for (int j = 0; j < dst->cols; j++) {
-			MATRIX_AT(*dst, j, i) = (decimal_t) rand() / (decimal_t) RAND_MAX;
-		}
+		random_fill_uniform(random, &MATRIX_AT(*dst, 0, i), dst->cols, low, high);
 	}
 }
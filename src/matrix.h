@@ -12,6 +12,7 @@ typedef MATRIX_DECIMAL decimal_t;
 typedef MATRIX_INTEGER integer_t;
 #endif
 
+struct random_t;
 
 struct matrix_t {
 	integer_t cols;
@@ -25,11 +26,13 @@ struct matrix_t matrix_from(decimal_t *items, integer_t cols, integer_t rows, in
 
 void matrix_set_size(struct matrix_t *matrix, integer_t cols, integer_t rows);
 
-void matrix_rand(struct matrix_t *matrix);
+void matrix_rand(struct matrix_t *matrix, struct random_t *random, decimal_t low, decimal_t high);
 void matrix_fill(struct matrix_t *matrix, decimal_t value);
 
 void matrix_add(struct matrix_t *sum, struct matrix_t *const a, struct matrix_t *const b);
 void matrix_mul(struct matrix_t *product, struct matrix_t *const a, struct matrix_t *const b);
+// product = a * transpose(b), b holds one row per column of product
+void matrix_mul_transposed(struct matrix_t *product, struct matrix_t *const a, struct matrix_t *const b);
 
 void matrix_print(struct matrix_t *matrix);
 
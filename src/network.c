@@ -6,9 +6,14 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "network.h"
 #include "matrix.h"
+#include "random.h"
 
 static void network_alloc_matrices(struct network_t *network, integer_t layer_count) {
 	network->matrices = calloc(layer_count * 6 - 4, sizeof(struct matrix_t));
@@ -24,7 +29,10 @@ static void network_alloc_matrices(struct network_t *network, integer_t layer_co
 }
 
 static void network_alloc_buffer(struct network_t *network, integer_t total_length) {
+	network->buffer_length = total_length;
 	network->buffer = calloc(total_length, sizeof(decimal_t));
+	assert(network->buffer != NULL);
+
 	decimal_t *ptr = network->buffer + 0;
 	network->matrices[0].items = ptr;
 	for (int i = 1; i < network->layer_count * 6 - 4; i++) {
@@ -33,27 +41,84 @@ static void network_alloc_buffer(struct network_t *network, integer_t total_leng
 	}
 }
 
+// weights matrices are sized by layout, the items they point at stay put
+static void network_size_weights(struct network_t *network, enum network_layout_t layout) {
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		integer_t previous_neuron_count = network->activations[NETWORK_ORIGINAL][i].cols;
+		integer_t neuron_count = network->activations[NETWORK_ORIGINAL][i + 1].cols;
+
+		for (int j = NETWORK_ORIGINAL; j <= NETWORK_GRADIENT; j++) {
+			struct matrix_t *weights = network->weights[j] + i;
+
+			if (layout == NETWORK_LAYOUT_IN_OUT) {
+				matrix_set_size(weights, neuron_count, previous_neuron_count);
+			} else {
+				matrix_set_size(weights, previous_neuron_count, neuron_count);
+			}
+		}
+	}
+
+	network->layout = layout;
+}
+
+static integer_t network_parameter_length(struct network_t *network) {
+	integer_t length = 0;
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		struct matrix_t *biases = network->biases[NETWORK_ORIGINAL] + i;
+		length += weights->cols * weights->rows + biases->cols;
+	}
+
+	return length;
+}
+
+static void network_write(int file, void const *data, size_t size) {
+	ssize_t written = write(file, data, size);
+	assert(written == size);
+}
+
 struct network_t network_new(integer_t layer_count, ...) {
 	assert(layer_count > 1);
 
+	integer_t neuron_counts[layer_count];
+
+	va_list args;
+	va_start(args, layer_count);
+	for (int i = 0; i < layer_count; i++) {
+		neuron_counts[i] = va_arg(args, integer_t);
+	}
+	va_end(args);
+
+	return network_from(layer_count, neuron_counts);
+}
+
+struct network_t network_from(integer_t layer_count, integer_t const *neuron_counts) {
+	assert(layer_count > 1);
+
 	struct network_t self;
 
 	self.layer_count = layer_count;
+	self.activation.mode = ACTIVATION_IDENTITY;
 	self.activation.function = activation_identity;
 	self.activation.derivative = activation_identity_derivative;
+	self.layout = NETWORK_LAYOUT_IN_OUT;
+	self.mapping = NULL;
+	self.mapping_size = 0;
 
 	network_alloc_matrices(&self, layer_count);
 
-	va_list args;
-	va_start(args, layer_count);
-	integer_t total_length = 0;
-	integer_t input_count = va_arg(args, integer_t);
+	self.reduction = NULL;
+	self.sparse = calloc(layer_count - 1, sizeof(struct sparse_t));
+	assert(self.sparse != NULL);
+
+	integer_t input_count = neuron_counts[0];
+	integer_t total_length = 2 * input_count;
 
 	matrix_set_size(self.activations[NETWORK_ORIGINAL] + 0, input_count, 1);
 	matrix_set_size(self.activations[NETWORK_GRADIENT] + 0, input_count, 1);
 
 	for (int i = 0; i < layer_count - 1; i++) {
-		integer_t neuron_count = va_arg(args, integer_t);
+		integer_t neuron_count = neuron_counts[i + 1];
 		integer_t previous_neuron_count = self.activations[NETWORK_ORIGINAL][i].cols;
 
 		for (int j = 0; j < 2; j++) {
@@ -66,11 +131,101 @@ struct network_t network_new(integer_t layer_count, ...) {
 
 	network_alloc_buffer(&self, total_length);
 
-	va_end(args);
+	return self;
+}
+
+struct network_t network_load(char const *path) {
+	int file = open(path, O_RDONLY);
+	assert(file != -1);
+
+	struct stat status;
+	int result = fstat(file, &status);
+	assert(result != -1);
+	assert(status.st_size >= sizeof(struct network_checkpoint_t));
+
+	// private writable mapping: pages stay shared in the page cache
+	// until someone trains on top of the loaded weights
+	size_t mapping_size = status.st_size;
+	void *mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	assert(mapping != MAP_FAILED);
+	close(file);
+
+	struct network_checkpoint_t *header = mapping;
+	assert(header->magic == NETWORK_CHECKPOINT_MAGIC);
+	assert(header->version == NETWORK_CHECKPOINT_VERSION);
+	assert(header->decimal_size == sizeof(decimal_t));
+
+	assert(sizeof(*header) + header->layer_count * sizeof(integer_t) <= mapping_size);
+
+	integer_t *neuron_counts = (integer_t *) (header + 1);
+	struct network_t self = network_from(header->layer_count, neuron_counts);
+	network_set_activation(&self, header->activation);
+	network_size_weights(&self, header->layout);
+
+	integer_t parameter_length = network_parameter_length(&self);
+	assert(header->parameter_offset % sizeof(decimal_t) == 0);
+	assert(header->parameter_offset + parameter_length * sizeof(decimal_t) <= mapping_size);
+
+	// the original weights and biases inside self.buffer are left untouched,
+	// calloc hands out lazily zeroed pages so they cost no resident memory
+	decimal_t *ptr = (decimal_t *) ((char *) mapping + header->parameter_offset);
+	for (int i = 0; i < self.layer_count - 1; i++) {
+		struct matrix_t *weights = self.weights[NETWORK_ORIGINAL] + i;
+		struct matrix_t *biases = self.biases[NETWORK_ORIGINAL] + i;
+
+		weights->items = ptr;
+		ptr += weights->cols * weights->rows;
+		biases->items = ptr;
+		ptr += biases->cols;
+	}
+
+	self.mapping = mapping;
+	self.mapping_size = mapping_size;
+
+	// a pruned checkpoint goes straight onto the sparse kernels
+	network_prune(&self, 0);
 
 	return self;
 }
 
+void network_save(struct network_t *network, char const *path) {
+	int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	assert(file != -1);
+
+	struct network_checkpoint_t header;
+	header.magic = NETWORK_CHECKPOINT_MAGIC;
+	header.version = NETWORK_CHECKPOINT_VERSION;
+	header.decimal_size = sizeof(decimal_t);
+	header.layer_count = network->layer_count;
+	header.activation = network->activation.mode;
+	header.layout = network->layout;
+
+	integer_t header_length = sizeof(header) + network->layer_count * sizeof(integer_t);
+	header.parameter_offset =
+		(header_length + NETWORK_CHECKPOINT_ALIGN - 1) /
+		NETWORK_CHECKPOINT_ALIGN * NETWORK_CHECKPOINT_ALIGN;
+
+	network_write(file, &header, sizeof(header));
+	for (int i = 0; i < network->layer_count; i++) {
+		integer_t neuron_count = network->activations[NETWORK_ORIGINAL][i].cols;
+		network_write(file, &neuron_count, sizeof(integer_t));
+	}
+
+	off_t offset = lseek(file, header.parameter_offset, SEEK_SET);
+	assert(offset == header.parameter_offset);
+
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		struct matrix_t *biases = network->biases[NETWORK_ORIGINAL] + i;
+
+		network_write(file, weights->items, weights->cols * weights->rows * sizeof(decimal_t));
+		network_write(file, biases->items, biases->cols * sizeof(decimal_t));
+	}
+
+	fsync(file);
+	close(file);
+}
+
 void network_set_activation(struct network_t *network, enum activation_variant_t variant) {
 	network->activation.mode = variant;
 	switch (variant) {
@@ -87,10 +242,76 @@ void network_set_activation(struct network_t *network, enum activation_variant_t
 	}
 }
 
-void network_randomize(struct network_t *network) {
+// transposes in place, cols and rows of the matrix swap too
+static void network_transpose(struct matrix_t *weights) {
+	integer_t weights_length = weights->rows * weights->cols;
+
+	assert(weights->stride == weights->cols);
+
+	decimal_t *items = malloc(weights_length * sizeof(decimal_t));
+	assert(items != NULL);
+
+	memcpy(items, weights->items, weights_length * sizeof(decimal_t));
+	struct matrix_t copy = matrix_from(items, weights->cols, weights->rows, weights->cols);
+
+	matrix_set_size(weights, copy.rows, copy.cols);
+	for (int row = 0; row < weights->rows; row++) {
+		for (int col = 0; col < weights->cols; col++) {
+			MATRIX_AT(*weights, col, row) = MATRIX_AT(copy, row, col);
+		}
+	}
+
+	free(items);
+}
+
+void network_set_layout(struct network_t *network, enum network_layout_t layout) {
+	if (network->layout == layout) return;
+
 	for (int i = 0; i < network->layer_count - 1; i++) {
-		matrix_rand(network->weights[NETWORK_ORIGINAL] + i);
-		matrix_rand(network->biases[NETWORK_ORIGINAL] + i);
+		for (int j = NETWORK_ORIGINAL; j <= NETWORK_GRADIENT; j++) {
+			network_transpose(network->weights[j] + i);
+		}
+	}
+
+	network_size_weights(network, layout);
+
+	// pruned layers keep their pattern, only the row order changes
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct sparse_t *sparse = network->sparse + i;
+		if (sparse->offsets == NULL) continue;
+
+		sparse_free(sparse);
+		*sparse = sparse_from(network->weights[NETWORK_ORIGINAL] + i);
+	}
+}
+
+void network_randomize(struct network_t *network, uint64_t seed) {
+	// every layer draws from its own stream, so layers can be
+	// initialized in any order or in parallel with identical results
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		struct matrix_t *biases = network->biases[NETWORK_ORIGINAL] + i;
+		struct random_t random = random_new(seed, i);
+
+		// fresh weights are dense, a CSR copy of the old ones would go stale
+		sparse_free(network->sparse + i);
+
+		assert(weights->stride == weights->cols);
+		random_fill_xavier(
+			&random,
+			weights->items,
+			weights->cols * weights->rows,
+			weights->rows,
+			weights->cols
+		);
+		matrix_fill(biases, 0);
+
+		// numbers are drawn in [in][out] order whatever the layout,
+		// so a seed gives the same network in either layout
+		if (network->layout != NETWORK_LAYOUT_IN_OUT) {
+			matrix_set_size(weights, weights->rows, weights->cols);
+			network_transpose(weights);
+		}
 	}
 }
 
@@ -110,15 +331,44 @@ void network_forward(struct network_t *network, decimal_t *items) {
 		MATRIX_AT(*input, i, 0) = items[i];
 	}
 
-	for (int i = 0; i < network->layer_count - 1; i++) {
-		struct matrix_t *activation_layer = network->activations[NETWORK_ORIGINAL] + i;
+	network_forward_batch(network, network->activations[NETWORK_ORIGINAL]);
+}
+
+void network_forward_batch(struct network_t *network, struct matrix_t *activations) {
+	network_forward_range(network, activations, 0, network->layer_count - 1);
+}
+
+void network_forward_range(
+	struct network_t *network,
+	struct matrix_t *activations,
+	integer_t first_layer,
+	integer_t last_layer
+) {
+	assert(last_layer < network->layer_count);
+
+	for (int i = first_layer; i < last_layer; i++) {
+		struct matrix_t *activation_layer = activations + i;
 		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
 		struct matrix_t *biases = network->biases[NETWORK_ORIGINAL] + i;
+		struct matrix_t *layer = activation_layer + 1;
+
+		assert(layer->rows == activation_layer->rows);
 
-		matrix_mul(activation_layer + 1, activation_layer, weights);
-		matrix_add(activation_layer + 1, activation_layer + 1, biases);
+		bool sparse = network->sparse[i].offsets != NULL;
+		if (network->layout == NETWORK_LAYOUT_IN_OUT) {
+			if (sparse) sparse_mul(layer, activation_layer, network->sparse + i);
+			else matrix_mul(layer, activation_layer, weights);
+		} else {
+			if (sparse) sparse_mul_transposed(layer, activation_layer, network->sparse + i);
+			else matrix_mul_transposed(layer, activation_layer, weights);
+		}
 
-		network_activate(network, i + 1);
+		for (int row = 0; row < layer->rows; row++) {
+			for (int col = 0; col < layer->cols; col++) {
+				decimal_t x = MATRIX_AT(*layer, col, row) + MATRIX_AT(*biases, col, 0);
+				MATRIX_AT(*layer, col, row) = network->activation.function(x);
+			}
+		}
 	}
 }
 
@@ -131,73 +381,173 @@ void network_activate(struct network_t *network, integer_t layer_index) {
 	}
 }
 
-void network_backpropagate(
+static void network_backpropagate_sample(
 	struct network_t *network,
-	struct matrix_t *const training_input,
-	struct matrix_t *const training_output
+	decimal_t *inputs,
+	decimal_t *expected_outputs
 ) {
 	struct matrix_t *activations = network->activations[NETWORK_ORIGINAL];
 	struct matrix_t *activationsg = network->activations[NETWORK_GRADIENT];
-	struct matrix_t *input = activations + 0;
 	struct matrix_t *output = activations + (network->layer_count - 1);
 	struct matrix_t *outputg = activationsg + (network->layer_count - 1);
 
-	assert(input->cols == training_input->cols);
-	assert(output->cols == training_output->cols);
-	assert(training_input->rows == training_output->rows);
+	network_forward(network, inputs);
+	for (int j = 0; j < network->layer_count; j++) {
+		matrix_fill(activationsg + j, 0);
+	}
 
-	int sample_length = training_input->rows;
+	for (int j = 0; j < output->cols; j++) {
+		decimal_t predicted = output->items[j];
+		decimal_t expected = expected_outputs[j];
 
-	network_reset_gradient(network);
+		outputg->items[j] = 2 * (predicted - expected);
+	}
 
-	// calculate gradients
-	for (int i = 0; i < sample_length; i++) {
-		decimal_t *inputs = &MATRIX_AT(*training_input, 0, i);
+	for (int j = network->layer_count - 1; j > 0; j--) {
+		network_backpropagate_layer(
+			network,
+			j,
+			activations + j,
+			activationsg + j,
+			activations + j - 1,
+			activationsg + j - 1
+		);
+	}
+}
 
-		network_forward(network, inputs);
-		for (int j = 0; j < network->layer_count; j++) {
-			matrix_fill(activationsg + j, 0);
-		}
+void network_backpropagate_layer(
+	struct network_t *network,
+	integer_t layer_index,
+	struct matrix_t *const layer,
+	struct matrix_t *const layerg,
+	struct matrix_t *const player,
+	struct matrix_t *playerg
+) {
+	struct matrix_t *biasg = network->biases[NETWORK_GRADIENT] + (layer_index - 1);
+	struct matrix_t *weightsg = network->weights[NETWORK_GRADIENT] + (layer_index - 1);
+	struct matrix_t *pweights = network->weights[NETWORK_ORIGINAL] + (layer_index - 1);
+
+	// layerg is not read again past this layer, so it keeps g * d
+	for (int k = 0; k < layer->cols; k++) {
+		decimal_t n = MATRIX_AT(*layer, k, 0);
+		decimal_t d = network->activation.derivative(n);
+		decimal_t g = MATRIX_AT(*layerg, k, 0) * d;
+
+		MATRIX_AT(*layerg, k, 0) = g;
+		biasg->items[k] += g;
+	}
 
-		for (int j = 0; j < training_output->cols; j++) {
-			decimal_t predicted = output->items[j];
-			decimal_t expected = MATRIX_AT(*training_output, j, i);
+	// the inner loop always runs along a row of pweights and weightsg,
+	// every gradient still sums over k in ascending order
+	if (network->layout == NETWORK_LAYOUT_IN_OUT) {
+		for (int l = 0; l < player->cols; l++) {
+			decimal_t prev_n = MATRIX_AT(*player, l, 0);
+			decimal_t prev_g = MATRIX_AT(*playerg, l, 0);
 
-			outputg->items[j] = 2 * (predicted - expected);
-		}
+			for (int k = 0; k < layer->cols; k++) {
+				decimal_t g = MATRIX_AT(*layerg, k, 0);
 
-		for (int j = network->layer_count - 1; j > 0; j--) {
-			struct matrix_t *layer = activations + j;
-			struct matrix_t *layerg = activationsg + j;
+				MATRIX_AT(*weightsg, k, l) += g * prev_n;
+				prev_g += g * MATRIX_AT(*pweights, k, l);
+			}
 
-			struct matrix_t *biasg = network->biases[NETWORK_GRADIENT] + (j - 1);
-			struct matrix_t *weightsg = network->weights[NETWORK_GRADIENT] + (j - 1);
+			MATRIX_AT(*playerg, l, 0) = prev_g;
+		}
+	} else {
+		for (int k = 0; k < layer->cols; k++) {
+			decimal_t g = MATRIX_AT(*layerg, k, 0);
 
-			// ahem, i mean previous layer
-			struct matrix_t *player = layer - 1;
-			struct matrix_t *playerg = layerg - 1;
-			struct matrix_t *pweights = network->weights[NETWORK_ORIGINAL] + (j - 1);
+			for (int l = 0; l < player->cols; l++) {
+				MATRIX_AT(*weightsg, l, k) += g * MATRIX_AT(*player, l, 0);
+				MATRIX_AT(*playerg, l, 0) += g * MATRIX_AT(*pweights, l, k);
+			}
+		}
+	}
+}
 
-			for (int k = 0; k < layer->cols; k++) {
-				decimal_t g = MATRIX_AT(*layerg, k, 0);
+void network_reduce_gradient(
+	struct network_t *network,
+	integer_t first_layer,
+	integer_t last_layer,
+	bool restore
+) {
+	assert(network->reduction != NULL);
+	assert(last_layer < network->layer_count);
 
-				decimal_t n = MATRIX_AT(*layer, k, 0);
-				decimal_t d = network->activation.derivative(n);
+	decimal_t *total = network->reduction;
 
-				biasg->items[k] += g * d;
+	for (int i = 0; i < last_layer; i++) {
+		struct matrix_t *gradients[2] = {
+			network->weights[NETWORK_GRADIENT] + i,
+			network->biases[NETWORK_GRADIENT] + i,
+		};
 
-				for (int l = 0; l < player->cols; l++) {
-					decimal_t prev_n = MATRIX_AT(*player, l, 0);
-					decimal_t w = MATRIX_AT(*pweights, k, l);
+		for (int j = 0; j < 2; j++) {
+			integer_t length = gradients[j]->rows * gradients[j]->cols;
+			if (i < first_layer) {
+				total += length;
+				continue;
+			}
 
-					MATRIX_AT(*weightsg, l, k) += g * d * prev_n;
-					playerg->items[l] += g * d * w;
+			for (int k = 0; k < length; k++) {
+				if (restore) {
+					gradients[j]->items[k] = total[k];
+					total[k] = 0;
+				} else {
+					total[k] += gradients[j]->items[k];
+					gradients[j]->items[k] = 0;
 				}
 			}
+			total += length;
 		}
 	}
+}
 
-	// average of the gradients
+void network_backpropagate(
+	struct network_t *network,
+	struct matrix_t *const training_input,
+	struct matrix_t *const training_output
+) {
+	struct matrix_t *input = network->activations[NETWORK_ORIGINAL] + 0;
+	struct matrix_t *output = network->activations[NETWORK_ORIGINAL] + (network->layer_count - 1);
+
+	assert(input->cols == training_input->cols);
+	assert(output->cols == training_output->cols);
+	assert(training_input->rows == training_output->rows);
+
+	int sample_length = training_input->rows;
+
+	network_reset_gradient(network);
+
+	// calculate gradients
+	if (network->reduction == NULL) {
+		for (int i = 0; i < sample_length; i++) {
+			network_backpropagate_sample(
+				network,
+				&MATRIX_AT(*training_input, 0, i),
+				&MATRIX_AT(*training_output, 0, i)
+			);
+		}
+	} else {
+		for (int i = 0; i < sample_length; i += NETWORK_REDUCTION_BLOCK) {
+			for (int j = i; j < sample_length && j < i + NETWORK_REDUCTION_BLOCK; j++) {
+				network_backpropagate_sample(
+					network,
+					&MATRIX_AT(*training_input, 0, j),
+					&MATRIX_AT(*training_output, 0, j)
+				);
+			}
+
+			network_reduce_gradient(network, 0, network->layer_count - 1, false);
+		}
+
+		network_reduce_gradient(network, 0, network->layer_count - 1, true);
+	}
+
+	network_average_gradient(network, sample_length);
+}
+
+void network_average_gradient(struct network_t *network, integer_t sample_length) {
 	for (int i = 0; i < network->layer_count - 1; i++) {
 		struct matrix_t *weights = network->weights[NETWORK_GRADIENT] + i;
 		struct matrix_t *biases = network->biases[NETWORK_GRADIENT] + i;
@@ -213,20 +563,97 @@ void network_backpropagate(
 	}
 }
 
+void network_set_deterministic(struct network_t *network, bool deterministic) {
+	free(network->reduction);
+	network->reduction = NULL;
+
+	if (!deterministic) return;
+
+	network->reduction = calloc(network_parameter_length(network), sizeof(decimal_t));
+	assert(network->reduction != NULL);
+}
+
+decimal_t network_check_gradient(
+	struct network_t *network,
+	struct matrix_t *const training_input,
+	struct matrix_t *const training_output,
+	decimal_t epsilon
+) {
+	network_backpropagate(network, training_input, training_output);
+
+	// network_cost averages over every output while backpropagation
+	// only averages over samples, hence the scale
+	decimal_t scale = training_output->cols;
+	decimal_t worst_error = 0;
+
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		assert(network->sparse[i].offsets == NULL);
+
+		struct matrix_t *parameters[2] = {
+			network->weights[NETWORK_ORIGINAL] + i,
+			network->biases[NETWORK_ORIGINAL] + i,
+		};
+		struct matrix_t *gradients[2] = {
+			network->weights[NETWORK_GRADIENT] + i,
+			network->biases[NETWORK_GRADIENT] + i,
+		};
+
+		for (int j = 0; j < 2; j++) {
+			integer_t length = parameters[j]->rows * parameters[j]->cols;
+
+			for (int k = 0; k < length; k++) {
+				decimal_t original = parameters[j]->items[k];
+
+				parameters[j]->items[k] = original + epsilon;
+				decimal_t cost_above = network_cost(network, training_input, training_output);
+				parameters[j]->items[k] = original - epsilon;
+				decimal_t cost_below = network_cost(network, training_input, training_output);
+				parameters[j]->items[k] = original;
+
+				decimal_t numeric = scale * (cost_above - cost_below) / (2 * epsilon);
+				decimal_t analytic = gradients[j]->items[k];
+				decimal_t magnitude = fabs(numeric) + fabs(analytic);
+				if (magnitude < NETWORK_GRADIENT_FLOOR * epsilon) {
+					magnitude = NETWORK_GRADIENT_FLOOR * epsilon;
+				}
+
+				decimal_t error = fabs(numeric - analytic) / magnitude;
+				if (error > worst_error) worst_error = error;
+			}
+		}
+	}
+
+	return worst_error;
+}
+
 void network_learn(struct network_t *network, decimal_t learning_rate) {
 	for (int i = 0; i < network->layer_count - 1; i++) {
 		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
 		struct matrix_t *biases = network->biases[NETWORK_ORIGINAL] + i;
 		struct matrix_t *weights_gradient = network->weights[NETWORK_GRADIENT] + i;
 		struct matrix_t *biases_gradient = network->biases[NETWORK_GRADIENT] + i;
+		struct sparse_t *sparse = network->sparse + i;
 
-		int weights_length = weights->rows * weights->cols;
-		for (int j = 0; j < weights_length; j++) {
-			int col = j % weights->cols;
-			int row = j / weights->cols;
+		if (sparse->offsets != NULL) {
+			// pruned weights stay pruned, only the kept ones are trained
+			for (int row = 0; row < sparse->rows; row++) {
+				for (integer_t p = sparse->offsets[row]; p < sparse->offsets[row + 1]; p++) {
+					integer_t col = sparse->indices[p];
 
-			decimal_t g = MATRIX_AT(*weights_gradient, col, row);
-			MATRIX_AT(*weights, col, row) -= learning_rate * g;
+					decimal_t g = MATRIX_AT(*weights_gradient, col, row);
+					MATRIX_AT(*weights, col, row) -= learning_rate * g;
+					sparse->items[p] = MATRIX_AT(*weights, col, row);
+				}
+			}
+		} else {
+			int weights_length = weights->rows * weights->cols;
+			for (int j = 0; j < weights_length; j++) {
+				int col = j % weights->cols;
+				int row = j / weights->cols;
+
+				decimal_t g = MATRIX_AT(*weights_gradient, col, row);
+				MATRIX_AT(*weights, col, row) -= learning_rate * g;
+			}
 		}
 
 		for (int j = 0; j < biases->cols; j++) {
@@ -236,6 +663,53 @@ void network_learn(struct network_t *network, decimal_t learning_rate) {
 	}
 }
 
+static int network_compare_magnitude(void const *a, void const *b) {
+	decimal_t x = fabs(*(decimal_t const *) a);
+	decimal_t y = fabs(*(decimal_t const *) b);
+	return (x > y) - (x < y);
+}
+
+// zero the smallest `ratio` of every layer's weights and move layers that
+// end up sparse enough onto CSR kernels, a ratio of 0 only converts layers
+// that are already sparse, e.g. after loading a pruned checkpoint
+void network_prune(struct network_t *network, decimal_t ratio) {
+	assert(ratio >= 0 && ratio < 1);
+
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		struct sparse_t *sparse = network->sparse + i;
+		integer_t weights_length = weights->rows * weights->cols;
+		integer_t pruned_length = ratio * weights_length;
+
+		assert(weights->stride == weights->cols);
+
+		// everything below the magnitude of the first kept weight goes
+		if (pruned_length > 0) {
+			decimal_t *sorted = malloc(weights_length * sizeof(decimal_t));
+			assert(sorted != NULL);
+
+			memcpy(sorted, weights->items, weights_length * sizeof(decimal_t));
+			qsort(sorted, weights_length, sizeof(decimal_t), network_compare_magnitude);
+			decimal_t cutoff = fabs(sorted[pruned_length]);
+			free(sorted);
+
+			for (int j = 0; j < weights_length; j++) {
+				if (fabs(weights->items[j]) < cutoff) weights->items[j] = 0;
+			}
+		}
+
+		integer_t nonzero_length = 0;
+		for (int j = 0; j < weights_length; j++) {
+			if (weights->items[j] != 0) nonzero_length += 1;
+		}
+
+		sparse_free(sparse);
+		if (nonzero_length > NETWORK_SPARSE_DENSITY * weights_length) continue;
+
+		*sparse = sparse_from(weights);
+	}
+}
+
 void network_print(struct network_t *network) {
 	fprintf(stderr, "NN -> LC: %d, NC: ", network->layer_count);
 	for (int i = 0; i < network->layer_count; i++) {
@@ -269,8 +743,18 @@ void network_print(struct network_t *network) {
 }
 
 void network_free(struct network_t *network) {
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		sparse_free(network->sparse + i);
+	}
+
+	free(network->sparse);
+	free(network->reduction);
 	free(network->matrices);
 	free(network->buffer);
+
+	if (network->mapping != NULL) {
+		munmap(network->mapping, network->mapping_size);
+	}
 }
 
 decimal_t network_cost(
@@ -288,6 +772,7 @@ decimal_t network_cost(
 	assert(network_output->cols == training_output->cols);
 
 	decimal_t cost = 0.0;
+	decimal_t block_cost = 0.0;
 	for (int i = 0; i < training_input->rows; i++) {
 		decimal_t *inputs = &MATRIX_AT(*training_input, 0, i);
 
@@ -297,9 +782,17 @@ decimal_t network_cost(
 			decimal_t a = MATRIX_AT(*network_output, j, 0);
 			decimal_t b = MATRIX_AT(*training_output, j, i);
 			decimal_t d = a - b;
-			cost += d * d;
+			block_cost += d * d;
 		}
+
+		// same block boundaries as network_backpropagate uses
+		if (network->reduction == NULL) continue;
+		if ((i + 1) % NETWORK_REDUCTION_BLOCK != 0) continue;
+
+		cost += block_cost;
+		block_cost = 0.0;
 	}
+	cost += block_cost;
 
 	return cost / (training_input->rows * training_output->cols);
 }
@@ -2,12 +2,43 @@
 #define NETWORK_H
 
 #include "matrix.h"
+#include "sparse.h"
+
+#include <stdbool.h>
+#include <stddef.h>
 
 #define NETWORK_ORIGINAL 0
 #define NETWORK_GRADIENT 1
 
+// layers whose share of nonzero weights drops to this switch to sparse kernels
+#define NETWORK_SPARSE_DENSITY	0.3
+
+// deterministic mode sums gradients and cost per block of this many samples
+// and adds the blocks up in order, so however blocks get spread over
+// threads the result is bit for bit the same
+#define NETWORK_REDUCTION_BLOCK	64
+// network_check_gradient divides by at least this many times epsilon,
+// finite differences carry an absolute error around cost precision / epsilon
+// that would otherwise pass for a large relative error on tiny gradients
+#define NETWORK_GRADIENT_FLOOR	10
+
+#define NETWORK_CHECKPOINT_DEFAULT_PATH	"dist/network.bin"
+#define NETWORK_CHECKPOINT_MAGIC	0x4E494143 // "CAIN"
+#define NETWORK_CHECKPOINT_VERSION	2
+// parameters start on a page boundary so the mapping can be shared as-is
+#define NETWORK_CHECKPOINT_ALIGN	4096
+
 typedef decimal_t (*activation_t)(decimal_t);
 
+// how weight matrices are stored, `[in][out]` keeps one row per input
+// neuron and the forward pass adds whole rows onto the output, `[out][in]`
+// keeps one row per output neuron and every output is a dot product,
+// either way forward, backward and learning walk the weights row by row
+enum network_layout_t {
+	NETWORK_LAYOUT_IN_OUT,
+	NETWORK_LAYOUT_OUT_IN,
+};
+
 enum activation_variant_t {
 	ACTIVATION_IDENTITY,
 	ACTIVATION_SIGMOID,
@@ -19,9 +50,25 @@ struct activation_t {
 	decimal_t (*derivative)(decimal_t);
 };
 
+// checkpoint file layout:
+// header, `layer_count` neuron counts, padding up to `parameter_offset`,
+// then weights and biases of every layer one after another,
+// weights stored in `layout` order
+struct network_checkpoint_t {
+	integer_t magic;
+	integer_t version;
+	integer_t decimal_size;
+	integer_t layer_count;
+	integer_t activation;
+	integer_t layout;
+	integer_t parameter_offset;
+};
+
 struct network_t {
 	// total length of layers
 	integer_t layer_count;
+	// total length of buffer
+	integer_t buffer_length;
 	// dynamically allocated storage for all numbers stored in the network
 	decimal_t *buffer;
 	// dynamically allocated storage for all matrices
@@ -33,17 +80,45 @@ struct network_t {
 	struct matrix_t *activations[2];
 	// activation function which can be customized by user
 	struct activation_t activation;
+	// storage order of every weights matrix, gradients included
+	enum network_layout_t layout;
+	// pruned copies of the original weights, one per layer,
+	// offsets stay NULL for layers still running dense
+	struct sparse_t *sparse;
+	// running gradient total of deterministic mode, NULL when disabled
+	decimal_t *reduction;
+	// checkpoint mapped by network_load, original weights and biases point into it
+	void *mapping;
+	size_t mapping_size;
 };
 
 struct network_t network_new(uint32_t layer_count, ...);
+struct network_t network_from(integer_t layer_count, integer_t const *neuron_counts);
+struct network_t network_load(char const *path);
+
+void network_save(struct network_t *network, char const *path);
 
 void network_set_activation(struct network_t *network, enum activation_variant_t variant);
+void network_set_deterministic(struct network_t *network, bool deterministic);
+// transposes every weights matrix into the given layout, pruned layers included
+void network_set_layout(struct network_t *network, enum network_layout_t layout);
 
-void network_randomize(struct network_t *network);
+void network_randomize(struct network_t *network, uint64_t seed);
 void network_reset_gradient(struct network_t *network);
 void network_forward(struct network_t *network, decimal_t *items);
+// runs every row of activations[0] through the network, activations holds
+// `layer_count` caller owned matrices, so concurrent callers never collide
+void network_forward_batch(struct network_t *network, struct matrix_t *activations);
+// same as network_forward_batch restricted to the weights of layers [first_layer, last_layer)
+void network_forward_range(
+	struct network_t *network,
+	struct matrix_t *activations,
+	integer_t first_layer,
+	integer_t last_layer
+);
 void network_activate(struct network_t *network, uint32_t layer_index);
 void network_learn(struct network_t *network, decimal_t learning_rate);
+void network_prune(struct network_t *network, decimal_t ratio);
 void network_print(struct network_t *network);
 void network_free(struct network_t *network);
 
@@ -53,6 +128,39 @@ void network_backpropagate(
 	struct matrix_t *const training_output
 );
 
+// largest relative error between network_backpropagate and
+// central finite differences of network_cost
+decimal_t network_check_gradient(
+	struct network_t *network,
+	struct matrix_t *const training_input,
+	struct matrix_t *const training_output,
+	decimal_t epsilon
+);
+
+// accumulates the gradient of a single sample through the weights feeding
+// `layer_index`, layerg is turned into the gradient before the activation
+// and playerg is added onto
+void network_backpropagate_layer(
+	struct network_t *network,
+	integer_t layer_index,
+	struct matrix_t *const layer,
+	struct matrix_t *const layerg,
+	struct matrix_t *const player,
+	struct matrix_t *playerg
+);
+
+// deterministic mode: moves the gradient of one reduction block of the weights
+// of layers [first_layer, last_layer) onto network->reduction, or with
+// `restore` moves the finished total back, the side moved from is left zeroed
+void network_reduce_gradient(
+	struct network_t *network,
+	integer_t first_layer,
+	integer_t last_layer,
+	bool restore
+);
+
+void network_average_gradient(struct network_t *network, integer_t sample_length);
+
 decimal_t network_cost(
 	struct network_t *network,
 	struct matrix_t *const training_input,
@@ -0,0 +1,311 @@
+#include <assert.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "pipeline.h"
+#include "network.h"
+#include "matrix.h"
+
+static void pipeline_push(struct pipeline_queue_t *queue, integer_t item) {
+	integer_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	while (tail - atomic_load_explicit(&queue->head, memory_order_acquire) == PIPELINE_QUEUE_LENGTH) {
+		sched_yield();
+	}
+
+	queue->items[tail % PIPELINE_QUEUE_LENGTH] = item;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+static integer_t pipeline_pop(struct pipeline_queue_t *queue) {
+	integer_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	while (atomic_load_explicit(&queue->tail, memory_order_acquire) == head) {
+		sched_yield();
+	}
+
+	integer_t item = queue->items[head % PIPELINE_QUEUE_LENGTH];
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+	return item;
+}
+
+// point `views` at one row of every layer in `source`
+static void pipeline_row(struct pipeline_t *pipeline, struct matrix_t *source, struct matrix_t *views, integer_t row) {
+	for (int i = 0; i < pipeline->network->layer_count; i++) {
+		views[i] = matrix_from(&MATRIX_AT(source[i], 0, row), source[i].cols, 1, source[i].stride);
+	}
+}
+
+static void pipeline_forward(struct pipeline_stage_t *stage, integer_t microbatch) {
+	struct pipeline_t *pipeline = stage->pipeline;
+	struct network_t *network = pipeline->network;
+	struct matrix_t *training_input = pipeline->training_input;
+
+	integer_t first_sample = microbatch * pipeline->microbatch_size;
+	integer_t sample_count = training_input->rows - first_sample;
+	if (sample_count > pipeline->microbatch_size) sample_count = pipeline->microbatch_size;
+
+	struct matrix_t views[network->layer_count];
+	for (int i = 0; i < network->layer_count; i++) {
+		struct matrix_t *layer = pipeline->activations + i;
+		views[i] = matrix_from(&MATRIX_AT(*layer, 0, first_sample), layer->cols, sample_count, layer->stride);
+	}
+
+	if (stage->first_layer == 0) {
+		for (int i = 0; i < sample_count; i++) {
+			for (int j = 0; j < views[0].cols; j++) {
+				MATRIX_AT(views[0], j, i) = MATRIX_AT(*training_input, j, first_sample + i);
+			}
+		}
+	}
+
+	network_forward_range(network, views, stage->first_layer, stage->last_layer);
+}
+
+static void pipeline_backward(struct pipeline_stage_t *stage, integer_t microbatch) {
+	struct pipeline_t *pipeline = stage->pipeline;
+	struct network_t *network = pipeline->network;
+	struct matrix_t *training_output = pipeline->training_output;
+	integer_t output_layer = network->layer_count - 1;
+
+	integer_t first_sample = microbatch * pipeline->microbatch_size;
+	integer_t last_sample = first_sample + pipeline->microbatch_size;
+	if (last_sample > training_output->rows) last_sample = training_output->rows;
+
+	struct matrix_t layers[network->layer_count];
+	struct matrix_t layersg[network->layer_count];
+
+	// samples go in order, so every gradient is summed in the
+	// same order as network_backpropagate sums it
+	for (int i = first_sample; i < last_sample; i++) {
+		pipeline_row(pipeline, pipeline->activations, layers, i);
+		pipeline_row(pipeline, pipeline->gradients, layersg, i);
+
+		if (stage->last_layer == output_layer) {
+			for (int j = 0; j < layers[output_layer].cols; j++) {
+				decimal_t predicted = MATRIX_AT(layers[output_layer], j, 0);
+				decimal_t expected = MATRIX_AT(*training_output, j, i);
+
+				MATRIX_AT(layersg[output_layer], j, 0) = 2 * (predicted - expected);
+			}
+		}
+
+		for (int j = stage->last_layer; j > stage->first_layer; j--) {
+			network_backpropagate_layer(
+				network,
+				j,
+				layers + j,
+				layersg + j,
+				layers + j - 1,
+				layersg + j - 1
+			);
+		}
+
+		// same block boundaries as network_backpropagate, each stage
+		// reduces the weights it owns
+		if (network->reduction == NULL) continue;
+		if ((i + 1) % NETWORK_REDUCTION_BLOCK != 0 && i + 1 != training_output->rows) continue;
+
+		network_reduce_gradient(network, stage->first_layer, stage->last_layer, false);
+	}
+}
+
+static void *pipeline_run(void *argument) {
+	struct pipeline_stage_t *stage = argument;
+	struct pipeline_t *pipeline = stage->pipeline;
+	bool first_stage = stage->index == 0;
+	bool last_stage = stage->index == pipeline->stage_count - 1;
+
+	while (true) {
+		pthread_barrier_wait(&pipeline->started);
+		if (!pipeline->running) break;
+
+		// this stage adds onto the gradients of layers [first, last)
+		for (int i = stage->first_layer; i < stage->last_layer; i++) {
+			struct matrix_t *layer = pipeline->gradients + i;
+			for (int j = 0; j < pipeline->training_input->rows; j++) {
+				for (int k = 0; k < layer->cols; k++) {
+					MATRIX_AT(*layer, k, j) = 0;
+				}
+			}
+		}
+
+		// gpipe schedule: every micro-batch forward, then every one backward,
+		// the last stage turns each micro-batch around right away
+		for (int i = 0; i < pipeline->microbatch_count; i++) {
+			integer_t microbatch = first_stage ? i : pipeline_pop(pipeline->forward + stage->index - 1);
+			pipeline_forward(stage, microbatch);
+
+			if (!last_stage) {
+				pipeline_push(pipeline->forward + stage->index, microbatch);
+				continue;
+			}
+
+			pipeline_backward(stage, microbatch);
+			if (!first_stage) pipeline_push(pipeline->backward + stage->index - 1, microbatch);
+		}
+
+		for (int i = 0; i < pipeline->microbatch_count && !last_stage; i++) {
+			integer_t microbatch = pipeline_pop(pipeline->backward + stage->index);
+			pipeline_backward(stage, microbatch);
+
+			if (!first_stage) pipeline_push(pipeline->backward + stage->index - 1, microbatch);
+		}
+
+		if (pipeline->network->reduction != NULL) {
+			network_reduce_gradient(pipeline->network, stage->first_layer, stage->last_layer, true);
+		}
+
+		pthread_barrier_wait(&pipeline->finished);
+	}
+
+	return NULL;
+}
+
+static void pipeline_reserve(struct pipeline_t *pipeline, integer_t sample_length) {
+	if (sample_length <= pipeline->capacity) return;
+
+	struct network_t *network = pipeline->network;
+	for (int i = 0; i < network->layer_count; i++) {
+		integer_t cols = network->activations[NETWORK_ORIGINAL][i].cols;
+
+		free(pipeline->activations[i].items);
+		free(pipeline->gradients[i].items);
+		pipeline->activations[i] = matrix_new(cols, sample_length);
+		pipeline->gradients[i] = matrix_new(cols, sample_length);
+	}
+
+	pipeline->capacity = sample_length;
+}
+
+struct pipeline_t pipeline_new(struct network_t *network, integer_t stage_count, integer_t microbatch_size) {
+	struct pipeline_t self;
+
+	assert(stage_count > 0);
+	assert(microbatch_size > 0);
+
+	// a stage needs at least one layer of weights
+	if (stage_count > network->layer_count - 1) stage_count = network->layer_count - 1;
+
+	self.network = network;
+	self.stage_count = stage_count;
+	self.microbatch_size = microbatch_size;
+	self.capacity = 0;
+	self.microbatch_count = 0;
+	self.running = false;
+
+	self.stages = calloc(stage_count, sizeof(struct pipeline_stage_t));
+	self.forward = calloc(stage_count, sizeof(struct pipeline_queue_t));
+	self.backward = calloc(stage_count, sizeof(struct pipeline_queue_t));
+	self.activations = calloc(network->layer_count, sizeof(struct matrix_t));
+	self.gradients = calloc(network->layer_count, sizeof(struct matrix_t));
+	assert(self.stages != NULL && self.forward != NULL && self.backward != NULL);
+	assert(self.activations != NULL && self.gradients != NULL);
+
+	// split the layers into contiguous ranges of roughly equal weight count
+	integer_t total_work = 0;
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		total_work += weights->rows * weights->cols;
+	}
+
+	integer_t layer = 0;
+	integer_t work = 0;
+	for (int i = 0; i < stage_count; i++) {
+		struct pipeline_stage_t *stage = self.stages + i;
+		integer_t stages_left = stage_count - i - 1;
+
+		stage->index = i;
+		stage->first_layer = layer;
+
+		do {
+			struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + layer;
+			work += weights->rows * weights->cols;
+			layer += 1;
+		} while (
+			network->layer_count - 1 - layer > stages_left &&
+			(uint64_t) work * stage_count < (uint64_t) total_work * (i + 1)
+		);
+
+		if (stages_left == 0) layer = network->layer_count - 1;
+		stage->last_layer = layer;
+	}
+
+	return self;
+}
+
+void pipeline_start(struct pipeline_t *pipeline) {
+	assert(!pipeline->running);
+
+	pthread_barrier_init(&pipeline->started, NULL, pipeline->stage_count + 1);
+	pthread_barrier_init(&pipeline->finished, NULL, pipeline->stage_count + 1);
+	pipeline->running = true;
+
+	for (int i = 0; i < pipeline->stage_count; i++) {
+		struct pipeline_stage_t *stage = pipeline->stages + i;
+		stage->pipeline = pipeline;
+
+		int result = pthread_create(&stage->thread, NULL, pipeline_run, stage);
+		assert(result == 0);
+	}
+}
+
+void pipeline_backpropagate(
+	struct pipeline_t *pipeline,
+	struct matrix_t *const training_input,
+	struct matrix_t *const training_output
+) {
+	struct network_t *network = pipeline->network;
+	struct matrix_t *input = network->activations[NETWORK_ORIGINAL] + 0;
+	struct matrix_t *output = network->activations[NETWORK_ORIGINAL] + (network->layer_count - 1);
+
+	assert(pipeline->running);
+	assert(input->cols == training_input->cols);
+	assert(output->cols == training_output->cols);
+	assert(training_input->rows == training_output->rows);
+
+	integer_t sample_length = training_input->rows;
+
+	pipeline_reserve(pipeline, sample_length);
+	network_reset_gradient(network);
+
+	// grow micro-batches rather than let their count outrun the queues
+	integer_t microbatch_size = pipeline->microbatch_size;
+	integer_t minimum_size = (sample_length + PIPELINE_QUEUE_LENGTH - 1) / PIPELINE_QUEUE_LENGTH;
+	if (pipeline->microbatch_size < minimum_size) pipeline->microbatch_size = minimum_size;
+
+	pipeline->training_input = training_input;
+	pipeline->training_output = training_output;
+	pipeline->microbatch_count = (sample_length + pipeline->microbatch_size - 1) / pipeline->microbatch_size;
+
+	pthread_barrier_wait(&pipeline->started);
+	pthread_barrier_wait(&pipeline->finished);
+
+	pipeline->microbatch_size = microbatch_size;
+
+	network_average_gradient(network, sample_length);
+}
+
+void pipeline_stop(struct pipeline_t *pipeline) {
+	if (pipeline->running) {
+		pipeline->running = false;
+		pthread_barrier_wait(&pipeline->started);
+
+		for (int i = 0; i < pipeline->stage_count; i++) {
+			pthread_join(pipeline->stages[i].thread, NULL);
+		}
+
+		pthread_barrier_destroy(&pipeline->started);
+		pthread_barrier_destroy(&pipeline->finished);
+	}
+
+	for (int i = 0; i < pipeline->network->layer_count && pipeline->capacity > 0; i++) {
+		free(pipeline->activations[i].items);
+		free(pipeline->gradients[i].items);
+	}
+
+	free(pipeline->stages);
+	free(pipeline->forward);
+	free(pipeline->backward);
+	free(pipeline->activations);
+	free(pipeline->gradients);
+}
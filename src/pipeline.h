@@ -0,0 +1,68 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "network.h"
+#include "matrix.h"
+
+// micro-batches in flight between two neighbouring stages, at most this
+// many micro-batches are used per mini batch so no queue ever fills up
+#define PIPELINE_QUEUE_LENGTH	64
+
+// single producer, single consumer ring of micro-batch indices
+struct pipeline_queue_t {
+	_Atomic integer_t head;
+	_Atomic integer_t tail;
+	integer_t items[PIPELINE_QUEUE_LENGTH];
+};
+
+struct pipeline_stage_t {
+	struct pipeline_t *pipeline;
+	integer_t index;
+	// layers whose weights this stage owns, weights [first_layer, last_layer)
+	integer_t first_layer;
+	integer_t last_layer;
+	pthread_t thread;
+};
+
+struct pipeline_t {
+	struct network_t *network;
+	integer_t stage_count;
+	integer_t microbatch_size;
+	struct pipeline_stage_t *stages;
+	// forward[i] goes from stage i to i + 1, backward[i] from i + 1 to i
+	struct pipeline_queue_t *forward;
+	struct pipeline_queue_t *backward;
+
+	// activations and their gradients of every sample in the mini batch
+	integer_t capacity;
+	struct matrix_t *activations;
+	struct matrix_t *gradients;
+
+	// the mini batch being worked on
+	struct matrix_t *training_input;
+	struct matrix_t *training_output;
+	integer_t microbatch_count;
+
+	pthread_barrier_t started;
+	pthread_barrier_t finished;
+	bool running;
+};
+
+struct pipeline_t pipeline_new(struct network_t *network, integer_t stage_count, integer_t microbatch_size);
+
+void pipeline_start(struct pipeline_t *pipeline);
+
+// drop-in replacement for network_backpropagate with identical results
+void pipeline_backpropagate(
+	struct pipeline_t *pipeline,
+	struct matrix_t *const training_input,
+	struct matrix_t *const training_output
+);
+
+void pipeline_stop(struct pipeline_t *pipeline);
+
+#endif // !PIPELINE_H
@@ -0,0 +1,114 @@
+#include <math.h>
+
+#include "random.h"
+#include "matrix.h"
+
+// 53 random bits mapped onto [0, 1)
+#define RANDOM_TO_DECIMAL(X) ((decimal_t) ((X) >> 11) * 0x1.0p-53)
+
+static uint64_t random_splitmix(uint64_t *x) {
+	uint64_t z = (*x += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+static void random_step(struct random_t *random, uint64_t *block) {
+	uint64_t *s0 = random->state[0];
+	uint64_t *s1 = random->state[1];
+	uint64_t *s2 = random->state[2];
+	uint64_t *s3 = random->state[3];
+
+	for (int i = 0; i < RANDOM_LANES; i++) {
+		block[i] = s0[i] + s3[i];
+
+		uint64_t t = s1[i] << 17;
+		s2[i] ^= s0[i];
+		s3[i] ^= s1[i];
+		s1[i] ^= s2[i];
+		s0[i] ^= s3[i];
+		s2[i] ^= t;
+		s3[i] = (s3[i] << 45) | (s3[i] >> 19);
+	}
+}
+
+struct random_t random_new(uint64_t seed, uint64_t stream) {
+	struct random_t self;
+
+	uint64_t x = seed;
+	x = random_splitmix(&x) ^ stream;
+
+	for (int i = 0; i < RANDOM_LANES; i++) {
+		for (int j = 0; j < 4; j++) {
+			self.state[j][i] = random_splitmix(&x);
+		}
+	}
+
+	self.cached = 0;
+
+	return self;
+}
+
+uint64_t random_next(struct random_t *random) {
+	if (random->cached == 0) {
+		random_step(random, random->cache);
+		random->cached = RANDOM_LANES;
+	}
+
+	return random->cache[RANDOM_LANES - random->cached--];
+}
+
+decimal_t random_uniform(struct random_t *random) {
+	return RANDOM_TO_DECIMAL(random_next(random));
+}
+
+void random_fill_uniform(struct random_t *random, decimal_t *items, integer_t length, decimal_t low, decimal_t high) {
+	decimal_t range = high - low;
+	integer_t i = 0;
+
+	// drain the cache first so the sequence matches repeated random_next calls
+	for (; i < length && random->cached > 0; i++) {
+		items[i] = low + range * random_uniform(random);
+	}
+
+	uint64_t block[RANDOM_LANES];
+	for (; i + RANDOM_LANES <= length; i += RANDOM_LANES) {
+		random_step(random, block);
+		for (int j = 0; j < RANDOM_LANES; j++) {
+			items[i + j] = low + range * RANDOM_TO_DECIMAL(block[j]);
+		}
+	}
+
+	for (; i < length; i++) {
+		items[i] = low + range * random_uniform(random);
+	}
+}
+
+void random_fill_normal(struct random_t *random, decimal_t *items, integer_t length, decimal_t mean, decimal_t deviation) {
+	integer_t even_length = length & ~1u;
+
+	// box-muller turns every pair of uniforms into a pair of normals
+	random_fill_uniform(random, items, even_length, 0, 1);
+	for (integer_t i = 0; i < even_length; i += 2) {
+		decimal_t r = sqrt(-2 * log(1 - items[i]));
+		decimal_t theta = 2 * M_PI * items[i + 1];
+
+		items[i] = mean + deviation * r * cos(theta);
+		items[i + 1] = mean + deviation * r * sin(theta);
+	}
+
+	if (even_length == length) return;
+
+	decimal_t r = sqrt(-2 * log(1 - random_uniform(random)));
+	decimal_t theta = 2 * M_PI * random_uniform(random);
+	items[even_length] = mean + deviation * r * cos(theta);
+}
+
+void random_fill_xavier(struct random_t *random, decimal_t *items, integer_t length, integer_t fan_in, integer_t fan_out) {
+	decimal_t limit = sqrt(6.0 / (fan_in + fan_out));
+	random_fill_uniform(random, items, length, -limit, limit);
+}
+
+void random_fill_he(struct random_t *random, decimal_t *items, integer_t length, integer_t fan_in) {
+	random_fill_normal(random, items, length, 0, sqrt(2.0 / fan_in));
+}
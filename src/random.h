@@ -0,0 +1,31 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+#include "matrix.h"
+
+// xoshiro256+ runs this many independent generators side by side,
+// one step produces a whole block which the compiler can vectorize
+#define RANDOM_LANES 4
+
+struct random_t {
+	uint64_t state[4][RANDOM_LANES];
+	// outputs of the last step not handed out yet
+	uint64_t cache[RANDOM_LANES];
+	integer_t cached;
+};
+
+// the same (seed, stream) pair always yields the same sequence,
+// so work split by stream is reproducible no matter which thread runs it
+struct random_t random_new(uint64_t seed, uint64_t stream);
+
+uint64_t random_next(struct random_t *random);
+decimal_t random_uniform(struct random_t *random);
+
+void random_fill_uniform(struct random_t *random, decimal_t *items, integer_t length, decimal_t low, decimal_t high);
+void random_fill_normal(struct random_t *random, decimal_t *items, integer_t length, decimal_t mean, decimal_t deviation);
+void random_fill_xavier(struct random_t *random, decimal_t *items, integer_t length, integer_t fan_in, integer_t fan_out);
+void random_fill_he(struct random_t *random, decimal_t *items, integer_t length, integer_t fan_in);
+
+#endif // !RANDOM_H
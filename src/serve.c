@@ -0,0 +1,139 @@
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "network.h"
+#include "matrix.h"
+#include "random.h"
+#include "server.h"
+
+#define BENCH_FLAG		"--bench"
+#define BENCH_CLIENTS		64
+#define BENCH_REQUESTS		500
+#define REPORT_INTERVAL		1 // seconds
+
+struct client_t {
+	struct server_t *server;
+	integer_t index;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+void stop(int signal);
+void report(struct server_t *server, char const *label);
+void *bench(void *argument);
+
+int main(int argc, char **argv) {
+	// nn_serve [--bench] [checkpoint...]
+	bool benchmark = argc > 1 && strcmp(argv[1], BENCH_FLAG) == 0;
+	int first = benchmark ? 2 : 1;
+
+	struct network_t networks[SERVER_MAX_MODELS];
+	integer_t network_count = 0;
+
+	for (int i = first; i < argc && network_count < SERVER_MAX_MODELS; i++) {
+		networks[network_count++] = network_load(argv[i]);
+	}
+	if (network_count == 0) {
+		networks[network_count++] = network_load(NETWORK_CHECKPOINT_DEFAULT_PATH);
+	}
+
+	if (benchmark) {
+		// the same load under growing batch delays shows what waiting buys
+		uint64_t delays[] = {0, 50000, SERVER_DEFAULT_DELAY, 1000000};
+
+		for (int i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+			struct server_t server = server_new(SERVER_DEFAULT_WORKERS, delays[i]);
+			for (int j = 0; j < network_count; j++) {
+				server_add_model(&server, networks + j);
+			}
+			server_start(&server);
+
+			pthread_t clients[BENCH_CLIENTS];
+			struct client_t arguments[BENCH_CLIENTS];
+			for (int j = 0; j < BENCH_CLIENTS; j++) {
+				arguments[j].server = &server;
+				arguments[j].index = j;
+				int result = pthread_create(clients + j, NULL, bench, arguments + j);
+				assert(result == 0);
+			}
+
+			for (int j = 0; j < BENCH_CLIENTS; j++) {
+				pthread_join(clients[j], NULL);
+			}
+
+			char label[64];
+			snprintf(label, sizeof(label), "delay %6luus", delays[i] / 1000);
+			report(&server, label);
+			server_stop(&server);
+		}
+	} else {
+		struct server_t server = server_new(SERVER_DEFAULT_WORKERS, SERVER_DEFAULT_DELAY);
+		for (int i = 0; i < network_count; i++) {
+			server_add_model(&server, networks + i);
+		}
+		server_start(&server);
+		server_listen(&server, SERVER_DEFAULT_PATH);
+
+		signal(SIGINT, stop);
+		signal(SIGTERM, stop);
+		signal(SIGPIPE, SIG_IGN);
+
+		while (!stopping) {
+			sleep(REPORT_INTERVAL);
+			report(&server, SERVER_DEFAULT_PATH);
+		}
+
+		server_stop(&server);
+		unlink(SERVER_DEFAULT_PATH);
+	}
+
+	for (int i = 0; i < network_count; i++) {
+		network_free(networks + i);
+	}
+
+	return 0;
+}
+
+void stop(int signal) {
+	stopping = 1;
+}
+
+void report(struct server_t *server, char const *label) {
+	struct server_stats_t stats = server_stats(server);
+	fprintf(
+		stderr,
+		"%s -> requests: %lu, req/s: %.0lf, batch: %.1lf, p50: %.1lfus, p99: %.1lfus\n",
+		label,
+		stats.request_count,
+		stats.throughput,
+		stats.batch_size,
+		stats.p50,
+		stats.p99
+	);
+}
+
+void *bench(void *argument) {
+	struct client_t *client = argument;
+	struct server_t *server = client->server;
+	struct random_t random = random_new(0, client->index);
+
+	integer_t model = client->index % server->model_count;
+	struct network_t *network = server->queues[model].network;
+	integer_t input_count = network->activations[NETWORK_ORIGINAL][0].cols;
+	integer_t output_count = network->activations[NETWORK_ORIGINAL][network->layer_count - 1].cols;
+
+	decimal_t input[input_count];
+	decimal_t output[output_count];
+
+	for (int i = 0; i < BENCH_REQUESTS; i++) {
+		random_fill_uniform(&random, input, input_count, 0, 1);
+		server_infer(server, model, input, output);
+	}
+
+	return NULL;
+}
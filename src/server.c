@@ -0,0 +1,455 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "network.h"
+#include "matrix.h"
+
+struct server_connection_t {
+	struct server_t *server;
+	int socket;
+	pthread_t thread;
+	// set once server_serve returns, the thread is then ready to be joined
+	bool finished;
+	struct server_connection_t *next;
+};
+
+static uint64_t server_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static bool server_read_all(int file, void *data, size_t size) {
+	char *ptr = data;
+	while (size > 0) {
+		ssize_t length = read(file, ptr, size);
+		if (length <= 0) return false;
+		ptr += length;
+		size -= length;
+	}
+
+	return true;
+}
+
+static bool server_write_all(int file, void const *data, size_t size) {
+	char const *ptr = data;
+	while (size > 0) {
+		ssize_t length = write(file, ptr, size);
+		if (length <= 0) return false;
+		ptr += length;
+		size -= length;
+	}
+
+	return true;
+}
+
+static int server_compare_latency(void const *a, void const *b) {
+	uint64_t x = *(uint64_t const *) a;
+	uint64_t y = *(uint64_t const *) b;
+	return (x > y) - (x < y);
+}
+
+// pick the queue to serve next: a full one, or else the one whose oldest
+// request has used up its delay, otherwise report when that will happen
+static int server_pick(struct server_t *server, uint64_t now, uint64_t *deadline) {
+	int chosen = -1;
+	*deadline = UINT64_MAX;
+
+	for (int i = 0; i < server->model_count; i++) {
+		struct server_queue_t *queue = server->queues + i;
+		if (queue->length == 0) continue;
+		if (queue->length >= SERVER_MAX_BATCH) return i;
+
+		uint64_t due = queue->head->arrival + server->delay;
+		if (due < *deadline) {
+			*deadline = due;
+			chosen = i;
+		}
+	}
+
+	// a stopping server flushes whatever is left right away
+	if (chosen != -1 && (*deadline <= now || !server->running)) return chosen;
+
+	return -1;
+}
+
+static void *server_work(void *argument) {
+	struct server_t *server = argument;
+
+	// every worker owns batch sized activations for every model
+	struct matrix_t *scratch[SERVER_MAX_MODELS];
+	for (int i = 0; i < server->model_count; i++) {
+		struct network_t *network = server->queues[i].network;
+
+		scratch[i] = calloc(network->layer_count, sizeof(struct matrix_t));
+		assert(scratch[i] != NULL);
+		for (int j = 0; j < network->layer_count; j++) {
+			integer_t cols = network->activations[NETWORK_ORIGINAL][j].cols;
+			scratch[i][j] = matrix_new(cols, SERVER_MAX_BATCH);
+		}
+	}
+
+	struct server_request_t *batch[SERVER_MAX_BATCH];
+
+	pthread_mutex_lock(&server->lock);
+	while (true) {
+		uint64_t deadline;
+		int chosen = server_pick(server, server_now(), &deadline);
+
+		if (chosen == -1) {
+			if (!server->running && deadline == UINT64_MAX) break;
+
+			if (deadline == UINT64_MAX) {
+				pthread_cond_wait(&server->pending, &server->lock);
+			} else {
+				struct timespec until = {
+					.tv_sec = deadline / 1000000000ull,
+					.tv_nsec = deadline % 1000000000ull,
+				};
+				pthread_cond_timedwait(&server->pending, &server->lock, &until);
+			}
+			continue;
+		}
+
+		struct server_queue_t *queue = server->queues + chosen;
+		integer_t batch_size = 0;
+		while (queue->head != NULL && batch_size < SERVER_MAX_BATCH) {
+			batch[batch_size++] = queue->head;
+			queue->head = queue->head->next;
+			queue->length -= 1;
+		}
+		if (queue->head == NULL) queue->tail = NULL;
+
+		pthread_mutex_unlock(&server->lock);
+
+		struct network_t *network = queue->network;
+		struct matrix_t *activations = scratch[chosen];
+		struct matrix_t *input = activations + 0;
+		struct matrix_t *output = activations + (network->layer_count - 1);
+
+		for (int i = 0; i < network->layer_count; i++) {
+			activations[i].rows = batch_size;
+		}
+
+		for (int i = 0; i < batch_size; i++) {
+			memcpy(&MATRIX_AT(*input, 0, i), batch[i]->input, input->cols * sizeof(decimal_t));
+		}
+
+		network_forward_batch(network, activations);
+
+		for (int i = 0; i < batch_size; i++) {
+			memcpy(batch[i]->output, &MATRIX_AT(*output, 0, i), output->cols * sizeof(decimal_t));
+		}
+
+		uint64_t now = server_now();
+
+		pthread_mutex_lock(&server->lock);
+		for (int i = 0; i < batch_size; i++) {
+			server->latencies[server->request_count % SERVER_LATENCY_WINDOW] = now - batch[i]->arrival;
+			server->request_count += 1;
+			batch[i]->done = true;
+			pthread_cond_signal(&batch[i]->completed);
+		}
+		server->batch_count += 1;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	for (int i = 0; i < server->model_count; i++) {
+		struct network_t *network = server->queues[i].network;
+		for (int j = 0; j < network->layer_count; j++) {
+			free(scratch[i][j].items);
+		}
+		free(scratch[i]);
+	}
+
+	return NULL;
+}
+
+static void *server_serve(void *argument) {
+	struct server_connection_t *connection = argument;
+	struct server_t *server = connection->server;
+
+	decimal_t *input = NULL;
+	decimal_t *output = NULL;
+
+	// request: model index, input numbers; response: output numbers
+	while (true) {
+		integer_t model;
+		if (!server_read_all(connection->socket, &model, sizeof(integer_t))) break;
+		if (model >= server->model_count) break;
+
+		struct network_t *network = server->queues[model].network;
+		integer_t input_count = network->activations[NETWORK_ORIGINAL][0].cols;
+		integer_t output_count = network->activations[NETWORK_ORIGINAL][network->layer_count - 1].cols;
+
+		input = realloc(input, input_count * sizeof(decimal_t));
+		output = realloc(output, output_count * sizeof(decimal_t));
+		assert(input != NULL && output != NULL);
+
+		if (!server_read_all(connection->socket, input, input_count * sizeof(decimal_t))) break;
+		if (!server_infer(server, model, input, output)) break;
+		if (!server_write_all(connection->socket, output, output_count * sizeof(decimal_t))) break;
+	}
+
+	free(input);
+	free(output);
+
+	// the socket stays open until the thread is joined, so server_stop
+	// never shuts down a descriptor number that got reused meanwhile
+	pthread_mutex_lock(&server->lock);
+	connection->finished = true;
+	pthread_mutex_unlock(&server->lock);
+
+	return NULL;
+}
+
+static void server_join(struct server_connection_t *connection) {
+	pthread_join(connection->thread, NULL);
+	close(connection->socket);
+	free(connection);
+}
+
+// join connections whose client already went away
+static void server_reap(struct server_t *server) {
+	struct server_connection_t *finished = NULL;
+
+	pthread_mutex_lock(&server->lock);
+	struct server_connection_t **link = &server->connections;
+	while (*link != NULL) {
+		struct server_connection_t *connection = *link;
+		if (!connection->finished) {
+			link = &connection->next;
+			continue;
+		}
+
+		*link = connection->next;
+		connection->next = finished;
+		finished = connection;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	while (finished != NULL) {
+		struct server_connection_t *next = finished->next;
+		server_join(finished);
+		finished = next;
+	}
+}
+
+static void *server_accept(void *argument) {
+	struct server_t *server = argument;
+
+	while (true) {
+		int client = accept(server->socket, NULL, NULL);
+		if (client == -1 && errno == EINTR) continue;
+		if (client == -1) break;
+
+		server_reap(server);
+
+		struct server_connection_t *connection = malloc(sizeof(struct server_connection_t));
+		assert(connection != NULL);
+		connection->server = server;
+		connection->socket = client;
+		connection->finished = false;
+
+		pthread_mutex_lock(&server->lock);
+		connection->next = server->connections;
+		server->connections = connection;
+		pthread_mutex_unlock(&server->lock);
+
+		int result = pthread_create(&connection->thread, NULL, server_serve, connection);
+		assert(result == 0);
+	}
+
+	return NULL;
+}
+
+struct server_t server_new(integer_t worker_count, uint64_t delay) {
+	struct server_t self;
+
+	assert(worker_count > 0);
+
+	self.running = false;
+	self.delay = delay;
+	self.worker_count = worker_count;
+	self.workers = NULL;
+	self.model_count = 0;
+	self.socket = -1;
+	self.connections = NULL;
+	self.start = 0;
+	self.request_count = 0;
+	self.batch_count = 0;
+
+	return self;
+}
+
+integer_t server_add_model(struct server_t *server, struct network_t *network) {
+	assert(!server->running);
+	assert(server->model_count < SERVER_MAX_MODELS);
+
+	struct server_queue_t *queue = server->queues + server->model_count;
+	queue->network = network;
+	queue->head = NULL;
+	queue->tail = NULL;
+	queue->length = 0;
+
+	return server->model_count++;
+}
+
+void server_start(struct server_t *server) {
+	assert(!server->running);
+
+	// the timed wait for a batch to fill runs on the monotonic clock
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->pending, &attributes);
+	pthread_condattr_destroy(&attributes);
+
+	server->running = true;
+	server->start = server_now();
+
+	server->workers = calloc(server->worker_count, sizeof(pthread_t));
+	assert(server->workers != NULL);
+
+	for (int i = 0; i < server->worker_count; i++) {
+		int result = pthread_create(server->workers + i, NULL, server_work, server);
+		assert(result == 0);
+	}
+}
+
+void server_listen(struct server_t *server, char const *path) {
+	assert(server->running);
+	assert(server->socket == -1);
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	assert(strlen(path) < sizeof(address.sun_path));
+	strcpy(address.sun_path, path);
+
+	server->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert(server->socket != -1);
+
+	unlink(path);
+	int result = bind(server->socket, (struct sockaddr *) &address, sizeof(address));
+	assert(result != -1);
+	result = listen(server->socket, SOMAXCONN);
+	assert(result != -1);
+
+	result = pthread_create(&server->listener, NULL, server_accept, server);
+	assert(result == 0);
+}
+
+bool server_infer(struct server_t *server, integer_t model, decimal_t *input, decimal_t *output) {
+	struct server_request_t request;
+	request.input = input;
+	request.output = output;
+	request.arrival = server_now();
+	request.done = false;
+	request.next = NULL;
+	pthread_cond_init(&request.completed, NULL);
+
+	pthread_mutex_lock(&server->lock);
+	assert(model < server->model_count);
+
+	if (!server->running) {
+		pthread_mutex_unlock(&server->lock);
+		pthread_cond_destroy(&request.completed);
+		return false;
+	}
+
+	struct server_queue_t *queue = server->queues + model;
+	if (queue->tail != NULL) {
+		queue->tail->next = &request;
+	} else {
+		queue->head = &request;
+	}
+	queue->tail = &request;
+	queue->length += 1;
+
+	pthread_cond_signal(&server->pending);
+	while (!request.done) {
+		pthread_cond_wait(&request.completed, &server->lock);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	pthread_cond_destroy(&request.completed);
+
+	return true;
+}
+
+struct server_stats_t server_stats(struct server_t *server) {
+	struct server_stats_t stats;
+	uint64_t *latencies = malloc(sizeof(server->latencies));
+	assert(latencies != NULL);
+
+	pthread_mutex_lock(&server->lock);
+	stats.request_count = server->request_count;
+	stats.batch_count = server->batch_count;
+	memcpy(latencies, server->latencies, sizeof(server->latencies));
+	uint64_t elapsed = server_now() - server->start;
+	pthread_mutex_unlock(&server->lock);
+
+	integer_t length = stats.request_count < SERVER_LATENCY_WINDOW ?
+		stats.request_count :
+		SERVER_LATENCY_WINDOW;
+	qsort(latencies, length, sizeof(uint64_t), server_compare_latency);
+
+	stats.throughput = elapsed > 0 ? stats.request_count * 1e9 / elapsed : 0;
+	stats.batch_size = stats.batch_count > 0 ? (decimal_t) stats.request_count / stats.batch_count : 0;
+	stats.p50 = length > 0 ? latencies[(length - 1) / 2] / 1e3 : 0;
+	stats.p99 = length > 0 ? latencies[(length - 1) * 99 / 100] / 1e3 : 0;
+
+	free(latencies);
+
+	return stats;
+}
+
+void server_stop(struct server_t *server) {
+	if (server->socket != -1) {
+		shutdown(server->socket, SHUT_RDWR);
+		pthread_join(server->listener, NULL);
+		close(server->socket);
+		server->socket = -1;
+	}
+
+	// no new connections past this point, wake every client blocked in
+	// read and let in-flight requests finish while the workers still run
+	pthread_mutex_lock(&server->lock);
+	struct server_connection_t *connections = server->connections;
+	server->connections = NULL;
+	for (struct server_connection_t *connection = connections; connection != NULL; connection = connection->next) {
+		shutdown(connection->socket, SHUT_RDWR);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	while (connections != NULL) {
+		struct server_connection_t *next = connections->next;
+		server_join(connections);
+		connections = next;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	server->running = false;
+	pthread_cond_broadcast(&server->pending);
+	pthread_mutex_unlock(&server->lock);
+
+	for (int i = 0; i < server->worker_count; i++) {
+		pthread_join(server->workers[i], NULL);
+	}
+
+	free(server->workers);
+	server->workers = NULL;
+
+	pthread_mutex_destroy(&server->lock);
+	pthread_cond_destroy(&server->pending);
+}
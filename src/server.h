@@ -0,0 +1,83 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "network.h"
+#include "matrix.h"
+
+#define SERVER_DEFAULT_PATH	"dist/server.sock"
+#define SERVER_DEFAULT_WORKERS	4
+// how long the oldest request may wait for others to join its batch
+#define SERVER_DEFAULT_DELAY	200000 // ns
+#define SERVER_MAX_MODELS	16
+#define SERVER_MAX_BATCH	64
+// percentiles are taken over this many most recent requests
+#define SERVER_LATENCY_WINDOW	4096
+
+struct server_request_t {
+	decimal_t *input;
+	decimal_t *output;
+	uint64_t arrival;
+	bool done;
+	// only the waiting caller sleeps on it, so a batch wakes nobody else
+	pthread_cond_t completed;
+	struct server_request_t *next;
+};
+
+// requests waiting for one model, oldest first
+struct server_queue_t {
+	struct network_t *network;
+	struct server_request_t *head;
+	struct server_request_t *tail;
+	integer_t length;
+};
+
+struct server_stats_t {
+	uint64_t request_count;
+	uint64_t batch_count;
+	decimal_t throughput; // requests per second
+	decimal_t batch_size;
+	decimal_t p50; // microseconds
+	decimal_t p99;
+};
+
+struct server_t {
+	pthread_mutex_t lock;
+	// signalled when requests arrive or the server stops
+	pthread_cond_t pending;
+	bool running;
+
+	uint64_t delay;
+	integer_t worker_count;
+	pthread_t *workers;
+
+	integer_t model_count;
+	struct server_queue_t queues[SERVER_MAX_MODELS];
+
+	int socket;
+	pthread_t listener;
+	// connections still being served or waiting to be joined, newest first
+	struct server_connection_t *connections;
+
+	uint64_t start;
+	uint64_t request_count;
+	uint64_t batch_count;
+	uint64_t latencies[SERVER_LATENCY_WINDOW];
+};
+
+struct server_t server_new(integer_t worker_count, uint64_t delay);
+integer_t server_add_model(struct server_t *server, struct network_t *network);
+
+void server_start(struct server_t *server);
+void server_listen(struct server_t *server, char const *path);
+// blocks until the request ran as part of some batch, false once the server stopped
+bool server_infer(struct server_t *server, integer_t model, decimal_t *input, decimal_t *output);
+
+struct server_stats_t server_stats(struct server_t *server);
+
+void server_stop(struct server_t *server);
+
+#endif // !SERVER_H
@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "snapshot.h"
+#include "network.h"
+#include "matrix.h"
+
+static void snapshot_write_all(int file, void const *data, size_t size) {
+	ssize_t written = write(file, data, size);
+	assert(written == size);
+}
+
+static void snapshot_read_all(int file, void *data, size_t size) {
+	ssize_t length = read(file, data, size);
+	assert(length == size);
+}
+
+// non-blocking check whether the previous writer has finished
+static bool snapshot_busy(struct snapshot_t *snapshot) {
+	if (snapshot->writer <= 0) return false;
+
+	pid_t pid = waitpid(snapshot->writer, NULL, WNOHANG);
+	if (pid == 0) return true;
+
+	snapshot->writer = 0;
+	return false;
+}
+
+struct snapshot_t snapshot_new(char const *path) {
+	struct snapshot_t self;
+
+	self.path = path;
+	self.writer = 0;
+
+	return self;
+}
+
+void snapshot_write(struct snapshot_t *snapshot, struct network_t *network, struct snapshot_state_t *state) {
+	// the weights of a mapped checkpoint live outside the buffer
+	assert(network->mapping == NULL);
+
+	// never stall training on a slow disk, just skip this snapshot
+	if (snapshot_busy(snapshot)) return;
+
+	// the child gets a copy-on-write view of the buffer as it is right now,
+	// so the parent can keep training while the child writes it out
+	pid_t pid = fork();
+	assert(pid != -1);
+
+	if (pid > 0) {
+		snapshot->writer = pid;
+		return;
+	}
+
+	char temporary_path[256];
+	snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", snapshot->path);
+
+	int file = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file == -1) _exit(1);
+
+	struct snapshot_header_t header;
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.decimal_size = sizeof(decimal_t);
+	header.layer_count = network->layer_count;
+	header.layout = network->layout;
+	header.buffer_length = network->buffer_length;
+	header.state = *state;
+
+	snapshot_write_all(file, &header, sizeof(header));
+	for (int i = 0; i < network->layer_count; i++) {
+		integer_t neuron_count = network->activations[NETWORK_ORIGINAL][i].cols;
+		snapshot_write_all(file, &neuron_count, sizeof(integer_t));
+	}
+	snapshot_write_all(file, network->buffer, network->buffer_length * sizeof(decimal_t));
+
+	fsync(file);
+	close(file);
+
+	// readers only ever see a complete snapshot
+	_exit(rename(temporary_path, snapshot->path) == 0 ? 0 : 1);
+}
+
+bool snapshot_read(char const *path, struct network_t *network, struct snapshot_state_t *state) {
+	int file = open(path, O_RDONLY);
+	if (file == -1 && errno == ENOENT) return false;
+	assert(file != -1);
+
+	struct snapshot_header_t header;
+	snapshot_read_all(file, &header, sizeof(header));
+
+	assert(header.magic == SNAPSHOT_MAGIC);
+	assert(header.version == SNAPSHOT_VERSION);
+	assert(header.decimal_size == sizeof(decimal_t));
+	assert(header.layer_count == network->layer_count);
+	assert(header.layout == network->layout);
+	assert(header.buffer_length == network->buffer_length);
+	assert(network->mapping == NULL);
+
+	for (int i = 0; i < network->layer_count; i++) {
+		integer_t neuron_count;
+		snapshot_read_all(file, &neuron_count, sizeof(integer_t));
+		assert(neuron_count == network->activations[NETWORK_ORIGINAL][i].cols);
+	}
+
+	snapshot_read_all(file, network->buffer, network->buffer_length * sizeof(decimal_t));
+	*state = header.state;
+
+	close(file);
+
+	// rebuild CSR copies from the restored weights, pruned layers go sparse again
+	network_prune(network, 0);
+
+	return true;
+}
+
+void snapshot_close(struct snapshot_t *snapshot) {
+	if (snapshot->writer <= 0) return;
+
+	waitpid(snapshot->writer, NULL, 0);
+	snapshot->writer = 0;
+}
+
+void snapshot_remove(struct snapshot_t *snapshot) {
+	snapshot_close(snapshot);
+
+	char temporary_path[256];
+	snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", snapshot->path);
+
+	int result = unlink(snapshot->path);
+	assert(result == 0 || errno == ENOENT);
+	result = unlink(temporary_path);
+	assert(result == 0 || errno == ENOENT);
+}
@@ -0,0 +1,50 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "network.h"
+#include "matrix.h"
+
+#define SNAPSHOT_DEFAULT_PATH		"dist/snapshot.bin"
+#define SNAPSHOT_DEFAULT_INTERVAL	1000
+#define SNAPSHOT_MAGIC			0x504E5343 // "CSNP"
+#define SNAPSHOT_VERSION		2
+
+// everything besides network->buffer needed to continue a training run
+struct snapshot_state_t {
+	uint64_t epoch;
+	uint64_t seed;
+	decimal_t learning_rate;
+};
+
+// snapshot file layout:
+// header, `layer_count` neuron counts, then the whole network buffer
+struct snapshot_header_t {
+	integer_t magic;
+	integer_t version;
+	integer_t decimal_size;
+	integer_t layer_count;
+	integer_t layout;
+	integer_t buffer_length;
+	struct snapshot_state_t state;
+};
+
+struct snapshot_t {
+	char const *path;
+	// pid of the forked process still writing the previous snapshot
+	pid_t writer;
+};
+
+struct snapshot_t snapshot_new(char const *path);
+
+void snapshot_write(struct snapshot_t *snapshot, struct network_t *network, struct snapshot_state_t *state);
+bool snapshot_read(char const *path, struct network_t *network, struct snapshot_state_t *state);
+
+void snapshot_close(struct snapshot_t *snapshot);
+// closes the snapshot and deletes its file, once a run has finished
+// there is nothing left to resume
+void snapshot_remove(struct snapshot_t *snapshot);
+
+#endif // !SNAPSHOT_H
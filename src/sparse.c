@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "sparse.h"
+#include "matrix.h"
+
+struct sparse_t sparse_from(struct matrix_t *const dense) {
+	struct sparse_t self;
+
+	self.cols = dense->cols;
+	self.rows = dense->rows;
+	self.count = 0;
+
+	for (int i = 0; i < dense->rows; i++) {
+		for (int j = 0; j < dense->cols; j++) {
+			if (MATRIX_AT(*dense, j, i) != 0) self.count += 1;
+		}
+	}
+
+	self.offsets = calloc(self.rows + 1, sizeof(integer_t));
+	self.indices = calloc(self.count, sizeof(integer_t));
+	self.items = calloc(self.count, sizeof(decimal_t));
+	assert(self.offsets != NULL);
+	assert(self.count == 0 || (self.indices != NULL && self.items != NULL));
+
+	integer_t k = 0;
+	for (int i = 0; i < dense->rows; i++) {
+		self.offsets[i] = k;
+		for (int j = 0; j < dense->cols; j++) {
+			decimal_t value = MATRIX_AT(*dense, j, i);
+			if (value == 0) continue;
+
+			self.indices[k] = j;
+			self.items[k] = value;
+			k += 1;
+		}
+	}
+	self.offsets[self.rows] = k;
+
+	return self;
+}
+
+void sparse_mul(
+	struct matrix_t *product,
+	struct matrix_t *const a,
+	struct sparse_t *const b
+) {
+	assert(a->cols == b->rows);
+	assert(product->rows == a->rows);
+	assert(product->cols == b->cols);
+
+	for (int row = 0; row < product->rows; row++) {
+		for (int col = 0; col < product->cols; col++) {
+			MATRIX_AT(*product, col, row) = 0;
+		}
+
+		// scatter every row of b scaled by the matching entry of a,
+		// each product entry still sums over k in ascending order
+		for (int k = 0; k < b->rows; k++) {
+			decimal_t value = MATRIX_AT(*a, k, row);
+			if (value == 0) continue;
+
+			for (integer_t p = b->offsets[k]; p < b->offsets[k + 1]; p++) {
+				MATRIX_AT(*product, b->indices[p], row) += value * b->items[p];
+			}
+		}
+	}
+}
+
+void sparse_mul_transposed(
+	struct matrix_t *product,
+	struct matrix_t *const a,
+	struct sparse_t *const b
+) {
+	assert(a->cols == b->cols);
+	assert(product->rows == a->rows);
+	assert(product->cols == b->rows);
+
+	// gather the entries of a picked out by every row of b
+	for (int row = 0; row < product->rows; row++) {
+		for (int col = 0; col < product->cols; col++) {
+			decimal_t sum = 0;
+			for (integer_t p = b->offsets[col]; p < b->offsets[col + 1]; p++) {
+				sum += MATRIX_AT(*a, b->indices[p], row) * b->items[p];
+			}
+
+			MATRIX_AT(*product, col, row) = sum;
+		}
+	}
+}
+
+void sparse_free(struct sparse_t *sparse) {
+	free(sparse->offsets);
+	free(sparse->indices);
+	free(sparse->items);
+
+	sparse->offsets = NULL;
+	sparse->indices = NULL;
+	sparse->items = NULL;
+	sparse->count = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "matrix.h"
+
+// compressed sparse row storage, row `i` owns
+// items[offsets[i]] up to items[offsets[i + 1]]
+struct sparse_t {
+	integer_t cols;
+	integer_t rows;
+	integer_t count;
+	integer_t *offsets;
+	integer_t *indices;
+	decimal_t *items;
+};
+
+struct sparse_t sparse_from(struct matrix_t *const dense);
+
+void sparse_mul(struct matrix_t *product, struct matrix_t *const a, struct sparse_t *const b);
+// product = a * transpose(b), b holds one row per column of product
+void sparse_mul_transposed(struct matrix_t *product, struct matrix_t *const a, struct sparse_t *const b);
+
+void sparse_free(struct sparse_t *sparse);
+
+#endif // !SPARSE_H
@@ -0,0 +1,204 @@
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "telemetry.h"
+#include "history.h"
+#include "network.h"
+#include "matrix.h"
+
+static size_t telemetry_align(size_t size) {
+	return (size + TELEMETRY_ALIGN - 1) / TELEMETRY_ALIGN * TELEMETRY_ALIGN;
+}
+
+static struct telemetry_slot_t *telemetry_slot(struct telemetry_t *telemetry, uint64_t sequence) {
+	struct telemetry_header_t *header = telemetry->header;
+	char *slots = (char *) telemetry->mapping + header->slot_offset;
+
+	return (struct telemetry_slot_t *) (slots + (sequence % header->slot_count) * header->slot_size);
+}
+
+struct telemetry_t telemetry_new(char const *name, struct network_t *network) {
+	struct telemetry_t self;
+
+	integer_t frame_length = history_frame_length(network);
+	size_t slot_offset = telemetry_align(
+		sizeof(struct telemetry_header_t) +
+		network->layer_count * sizeof(integer_t)
+	);
+	size_t slot_size = telemetry_align(
+		sizeof(struct telemetry_slot_t) +
+		frame_length * sizeof(decimal_t)
+	);
+
+	self.name = name;
+	self.owner = true;
+	self.sequence = 0;
+	self.mapping_size = slot_offset + TELEMETRY_SLOT_COUNT * slot_size;
+
+	// never resize a segment an old reader may still have mapped, a fresh
+	// one replaces the name while the old one lives on until unmapped
+	shm_unlink(name);
+	self.file = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	assert(self.file != -1);
+
+	int result = ftruncate(self.file, self.mapping_size);
+	assert(result != -1);
+
+	self.mapping = mmap(NULL, self.mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, self.file, 0);
+	assert(self.mapping != MAP_FAILED);
+
+	// readers ignore the segment until the magic shows up again
+	self.header = self.mapping;
+	atomic_store_explicit(&self.header->magic, 0, memory_order_relaxed);
+	atomic_store_explicit(&self.header->head, 0, memory_order_relaxed);
+
+	self.header->layer_count = network->layer_count;
+	self.header->layout = network->layout;
+	self.header->frame_length = frame_length;
+	self.header->slot_count = TELEMETRY_SLOT_COUNT;
+	self.header->slot_offset = slot_offset;
+	self.header->slot_size = slot_size;
+
+	integer_t *neuron_counts = (integer_t *) (self.header + 1);
+	for (int i = 0; i < network->layer_count; i++) {
+		neuron_counts[i] = network->activations[NETWORK_ORIGINAL][i].cols;
+	}
+
+	for (int i = 0; i < TELEMETRY_SLOT_COUNT; i++) {
+		atomic_store_explicit(&telemetry_slot(&self, i)->sequence, 0, memory_order_relaxed);
+	}
+
+	atomic_store_explicit(&self.header->magic, TELEMETRY_MAGIC, memory_order_release);
+
+	return self;
+}
+
+bool telemetry_try_attach(char const *name, struct telemetry_t *telemetry) {
+	struct telemetry_t self;
+
+	self.name = name;
+	self.owner = false;
+	self.sequence = 0;
+
+	self.file = shm_open(name, O_RDONLY, 0);
+	if (self.file == -1) {
+		assert(errno == ENOENT);
+		return false;
+	}
+
+	// the producer sizes the segment right after creating it
+	struct stat status;
+	int result = fstat(self.file, &status);
+	assert(result != -1);
+	if (status.st_size < sizeof(struct telemetry_header_t)) {
+		close(self.file);
+		return false;
+	}
+
+	self.mapping_size = status.st_size;
+	self.mapping = mmap(NULL, self.mapping_size, PROT_READ, MAP_SHARED, self.file, 0);
+	assert(self.mapping != MAP_FAILED);
+
+	self.header = self.mapping;
+	if (!telemetry_alive(&self)) {
+		munmap(self.mapping, self.mapping_size);
+		close(self.file);
+		return false;
+	}
+
+	assert(self.header->slot_offset + self.header->slot_count * self.header->slot_size <= self.mapping_size);
+
+	*telemetry = self;
+	return true;
+}
+
+struct telemetry_t telemetry_attach(char const *name) {
+	struct telemetry_t self;
+	while (!telemetry_try_attach(name, &self)) {
+		usleep(1000);
+	}
+
+	return self;
+}
+
+void telemetry_publish(struct telemetry_t *telemetry, struct network_t *network, uint64_t epoch, decimal_t cost) {
+	// the weights of a mapped checkpoint live outside the buffer
+	assert(network->mapping == NULL);
+
+	struct telemetry_header_t *header = telemetry->header;
+	struct telemetry_slot_t *slot = telemetry_slot(telemetry, telemetry->sequence + 1);
+
+	// wait-free: the oldest slot is overwritten no matter who reads it,
+	// a reader caught mid-copy notices the sequence change and retries
+	telemetry->sequence += 1;
+	atomic_store_explicit(&slot->sequence, 2 * telemetry->sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	slot->epoch = epoch;
+	slot->cost = cost;
+	memcpy(slot + 1, network->buffer, header->frame_length * sizeof(decimal_t));
+
+	atomic_store_explicit(&slot->sequence, 2 * telemetry->sequence, memory_order_release);
+	atomic_store_explicit(&header->head, telemetry->sequence, memory_order_release);
+}
+
+struct network_t telemetry_read_cfg(struct telemetry_t *telemetry) {
+	integer_t *neuron_counts = (integer_t *) (telemetry->header + 1);
+	struct network_t network = network_from(telemetry->header->layer_count, neuron_counts);
+	network_set_layout(&network, telemetry->header->layout);
+
+	assert(history_frame_length(&network) == telemetry->header->frame_length);
+
+	return network;
+}
+
+bool telemetry_read_frame(struct telemetry_t *telemetry, struct network_t *network, uint64_t *epoch, decimal_t *cost) {
+	struct telemetry_header_t *header = telemetry->header;
+
+	// frames stay readable after the producer closed, so the last one is never lost
+	assert(header->frame_length == history_frame_length(network));
+
+	while (true) {
+		uint64_t head = atomic_load_explicit(&header->head, memory_order_acquire);
+		if (head == telemetry->sequence) return false;
+		if (head == 0) return false;
+
+		// a producer only ever counts up within one segment
+		assert(head > telemetry->sequence);
+
+		struct telemetry_slot_t *slot = telemetry_slot(telemetry, head);
+		uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+		if (before != 2 * head) continue;
+
+		*epoch = slot->epoch;
+		*cost = slot->cost;
+		memcpy(network->buffer, slot + 1, header->frame_length * sizeof(decimal_t));
+
+		atomic_thread_fence(memory_order_acquire);
+		uint64_t after = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+		if (after != before) continue;
+
+		telemetry->sequence = head;
+		return true;
+	}
+}
+
+bool telemetry_alive(struct telemetry_t *telemetry) {
+	return atomic_load_explicit(&telemetry->header->magic, memory_order_acquire) == TELEMETRY_MAGIC;
+}
+
+void telemetry_close(struct telemetry_t *telemetry) {
+	if (telemetry->owner) {
+		// readers stop waiting on a segment nobody writes to anymore
+		atomic_store_explicit(&telemetry->header->magic, 0, memory_order_release);
+		shm_unlink(telemetry->name);
+	}
+
+	munmap(telemetry->mapping, telemetry->mapping_size);
+	close(telemetry->file);
+}
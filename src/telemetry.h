@@ -0,0 +1,67 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "network.h"
+#include "matrix.h"
+
+#define TELEMETRY_DEFAULT_NAME	"/cai-telemetry"
+#define TELEMETRY_MAGIC		0x4D4C4554 // "TELM"
+// a reader has this many publishes to finish copying before its slot is reused
+#define TELEMETRY_SLOT_COUNT	8
+#define TELEMETRY_ALIGN		64
+
+// shared memory layout:
+// header, `layer_count` neuron counts, then `slot_count` slots
+// of `slot_size` bytes, each a telemetry_slot_t plus one history frame
+struct telemetry_header_t {
+	_Atomic integer_t magic;
+	integer_t layer_count;
+	integer_t layout;
+	integer_t frame_length;
+	integer_t slot_count;
+	integer_t slot_offset;
+	integer_t slot_size;
+	// sequence number of the newest complete frame, 0 before the first one
+	_Atomic uint64_t head;
+};
+
+struct telemetry_slot_t {
+	// seqlock, odd while the producer is writing the slot
+	_Atomic uint64_t sequence;
+	uint64_t epoch;
+	decimal_t cost;
+};
+
+struct telemetry_t {
+	char const *name;
+	// the producer unlinks the segment again on close
+	bool owner;
+	int file;
+	void *mapping;
+	size_t mapping_size;
+	struct telemetry_header_t *header;
+	// last sequence published or read by this side
+	uint64_t sequence;
+};
+
+struct telemetry_t telemetry_new(char const *name, struct network_t *network);
+// waits until a producer has created and initialized the segment
+struct telemetry_t telemetry_attach(char const *name);
+// same as telemetry_attach but gives up right away, false if no producer is there
+bool telemetry_try_attach(char const *name, struct telemetry_t *telemetry);
+
+void telemetry_publish(struct telemetry_t *telemetry, struct network_t *network, uint64_t epoch, decimal_t cost);
+struct network_t telemetry_read_cfg(struct telemetry_t *telemetry);
+bool telemetry_read_frame(struct telemetry_t *telemetry, struct network_t *network, uint64_t *epoch, decimal_t *cost);
+// false once the producer closed its segment, a restarted producer
+// creates a new one that has to be attached to again
+bool telemetry_alive(struct telemetry_t *telemetry);
+
+void telemetry_close(struct telemetry_t *telemetry);
+
+#endif // !TELEMETRY_H
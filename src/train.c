@@ -8,17 +8,39 @@
 #define USE_DIFFERENT_SEED	false
 #define USE_UNLIMITED_LOOP	true
 #define USE_HISTORY		true
+#define USE_CHECKPOINT		true
+#define USE_SNAPSHOT		true
+#define USE_TELEMETRY		true
 #define USE_DEBUG		false
+#define USE_GRADIENT_CHECK	false
+#define USE_DETERMINISTIC	false
+#define USE_PIPELINE		false
 
 #define LOOP_LIMIT		1
 #define COST_THRESHOLD		0.0001
+#define GRADIENT_EPSILON	1e-6
+#define GRADIENT_TOLERANCE	1e-4
+#define PIPELINE_STAGES		2
+#define PIPELINE_MICROBATCH	1
+#define WEIGHT_LAYOUT		NETWORK_LAYOUT_IN_OUT
 
 #if USE_HISTORY
 #include "history.h"
 #endif
 
-#ifdef USE_DIFFERENT_SEED
-#include <stdlib.h>
+#include "snapshot.h"
+
+#if USE_PIPELINE
+#include "pipeline.h"
+#endif
+
+#if USE_TELEMETRY
+#include <math.h>
+
+#include "telemetry.h"
+#endif
+
+#if USE_DIFFERENT_SEED
 #include <time.h>
 #endif
 
@@ -30,43 +52,102 @@ decimal_t samples[] = {
 };
 
 int main(void) {
+	struct snapshot_state_t state;
+	state.epoch = 0;
+	state.learning_rate = 10.0;
 
 #if USE_DIFFERENT_SEED
-	srand(time(0));
+	state.seed = time(0);
+#else
+	state.seed = 1;
 #endif
 
 	struct network_t network = network_new(3, 2, 2, 1);
-
-#if USE_HISTORY
-	struct history_t history = history_new(HISTORY_DEFAULT_PATH, O_WRONLY | O_CREAT);
-	history_write_cfg(&history, &network);
-#endif
+	network_set_layout(&network, WEIGHT_LAYOUT);
 
 	struct matrix_t training_input = matrix_from(samples + 0, 2, 4, 3);
 	struct matrix_t training_output = matrix_from(samples + 2, 1, 4, 3);
 
 	network_set_activation(&network, ACTIVATION_SIGMOID);
-	network_randomize(&network);
 
-	decimal_t learning_rate = 10.0;
+#if USE_SNAPSHOT
+	struct snapshot_t snapshot = snapshot_new(SNAPSHOT_DEFAULT_PATH);
+
+	if (snapshot_read(SNAPSHOT_DEFAULT_PATH, &network, &state)) {
+		fprintf(stderr, "resuming from epoch %lu\n", state.epoch);
+	} else {
+		network_randomize(&network, state.seed);
+	}
+#else // !USE_SNAPSHOT
+	network_randomize(&network, state.seed);
+#endif // USE_SNAPSHOT
+
+#if USE_DETERMINISTIC
+	network_set_deterministic(&network, true);
+#endif
+
+#if USE_GRADIENT_CHECK
+	// before history and telemetry get opened, a failed check leaves nothing behind
+	decimal_t gradient_error = network_check_gradient(
+		&network,
+		&training_input,
+		&training_output,
+		GRADIENT_EPSILON
+	);
+	fprintf(stderr, "gradient check: %e\n", gradient_error);
+	if (gradient_error > GRADIENT_TOLERANCE) return 1;
+#endif
+
+#if USE_HISTORY
+	// a resumed run appends right after the frame of the snapshot epoch
+	struct history_t history;
+	if (state.epoch > 0) {
+		history = history_new(HISTORY_DEFAULT_PATH, O_RDWR);
+		history_resume(&history, &network, state.epoch);
+	} else {
+		history = history_new(HISTORY_DEFAULT_PATH, O_WRONLY | O_CREAT | O_TRUNC);
+		history_write_cfg(&history, &network);
+	}
+#endif
+
+#if USE_TELEMETRY
+	struct telemetry_t telemetry = telemetry_new(TELEMETRY_DEFAULT_NAME, &network);
+#endif
+
+#if USE_PIPELINE
+	struct pipeline_t pipeline = pipeline_new(&network, PIPELINE_STAGES, PIPELINE_MICROBATCH);
+	pipeline_start(&pipeline);
+#endif
 
 #if USE_UNLIMITED_LOOP
 	decimal_t cost = network_cost(&network, &training_input, &training_output);
 
 	while (cost > COST_THRESHOLD) {
 #else // !USE_UNLIMITED_LOOP
-	for (int i = 0; i < LOOP_LIMIT; i++) {
+	while (state.epoch < LOOP_LIMIT) {
 #endif // USE_UNLIMITED_LOOP
 
+#if USE_PIPELINE
+		pipeline_backpropagate(&pipeline, &training_input, &training_output);
+#else // !USE_PIPELINE
 		network_backpropagate(&network, &training_input, &training_output);
-		network_learn(&network, learning_rate);
+#endif // USE_PIPELINE
+		network_learn(&network, state.learning_rate);
+		state.epoch += 1;
 
 #if USE_HISTORY
 #if !USE_UNLIMITED_LOOP
-		fprintf(stderr, "i: %d\n", i);
+		fprintf(stderr, "i: %lu\n", state.epoch - 1);
 #endif // !USE_UNLIMITED_LOOP
 		history_write_frame(&history, &network);
 #endif // USE_HISTORY
+
+#if USE_SNAPSHOT
+		// after the frame, so the recording always reaches the snapshot epoch
+		if (state.epoch % SNAPSHOT_DEFAULT_INTERVAL == 0) {
+			snapshot_write(&snapshot, &network, &state);
+		}
+#endif // USE_SNAPSHOT
        
 #if USE_DEBUG
 		network_print(&network);
@@ -78,8 +159,20 @@ int main(void) {
 		fprintf(stderr, "\tcost: %lf\n", cost);
 #endif // USE_DEBUG
 #endif // USE_UNLIMITED_LOOP
+
+#if USE_TELEMETRY
+#if USE_UNLIMITED_LOOP
+		telemetry_publish(&telemetry, &network, state.epoch, cost);
+#else // !USE_UNLIMITED_LOOP
+		telemetry_publish(&telemetry, &network, state.epoch, NAN);
+#endif // USE_UNLIMITED_LOOP
+#endif // USE_TELEMETRY
 	}
 
+#if USE_PIPELINE
+	pipeline_stop(&pipeline);
+#endif
+
 	struct matrix_t output = network.activations[NETWORK_ORIGINAL][network.layer_count - 1];
 	for (int i = 0; i < 2; i++) {
 		for (int j = 0; j < 2; j++) {
@@ -92,6 +185,19 @@ int main(void) {
 	history_close(&history);
 #endif
 
+#if USE_CHECKPOINT
+	network_save(&network, NETWORK_CHECKPOINT_DEFAULT_PATH);
+#endif
+
+#if USE_SNAPSHOT
+	// the run finished cleanly, the next one starts from scratch
+	snapshot_remove(&snapshot);
+#endif
+
+#if USE_TELEMETRY
+	telemetry_close(&telemetry);
+#endif
+
 	network_free(&network);
 
 	return 0;
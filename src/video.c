@@ -1,12 +1,18 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <math.h>
 
 #include <SDL.h>
 
 #include "matrix.h"
 #include "network.h"
+#include "history.h"
+#include "telemetry.h"
 
 #define COLOR_BACKGROUND 0x0B0F10
 #define COLOR_FOREGROUND 0xC5C8C9
@@ -37,21 +43,78 @@
 #define DEFAULT_WIN_WIDTH  800
 #define DEFAULT_WIN_HEIGHT 600
 
-void listen(SDL_Event *event);
+#define VIDEO_FRAME_RATE	60
+// history frames shown per second, the frames in between are interpolated
+#define VIDEO_HISTORY_RATE	15
+#define VIDEO_EDGE_WIDTH	1.5f
+#define VIDEO_EDGE_MIN_ALPHA	0x20
+#define VIDEO_HEADLESS_DRIVER	"dummy"
+#define VIDEO_LIVE_FLAG		"--live"
+// a headless live viewer gives up after this long without a new frame
+#define VIDEO_LIVE_TIMEOUT	1000
+
+struct video_t {
+	int width;
+	int height;
+	// neuron circles only change with the window size
+	SDL_Texture *neurons;
+	// all edges, a band is redrawn only when one of its edges changes color
+	SDL_Texture *edges;
+	// one quad per weight, positions are laid out once and
+	// colors are patched in place for the edges that changed
+	integer_t edge_count;
+	SDL_Vertex *vertices;
+	int *indices;
+	Uint32 *colors;
+	// the edges feeding layer i + 1 stay between the neurons of layers i
+	// and i + 1, so each layer of weights owns a vertical band of the texture
+	integer_t band_count;
+	// first edge of every band, band_count + 1 entries
+	integer_t *band_offsets;
+	SDL_Rect *bands;
+	bool *dirty;
+	// weights of the history frames being interpolated between
+	decimal_t *from;
+	decimal_t *to;
+};
+
+bool listen(SDL_Event *event);
+
+struct video_t video_new(struct network_t *network);
+void video_layout(struct video_t *video, SDL_Renderer *renderer, struct network_t *network, int width, int height);
+integer_t video_update(struct video_t *video, decimal_t progress);
+void video_push_frame(struct video_t *video, struct network_t *network);
+void video_free(struct video_t *video);
+
 void render(
 	struct SDL_Window *window,
 	struct SDL_Renderer *renderer,
-	struct network_t *network
+	struct network_t *network,
+	struct video_t *video,
+	decimal_t progress
 );
 
-void SDL_RenderDrawCircle(SDL_Renderer *renderer, int center_x, int center_y, int radius);
+int SDL_CircleToPoints(SDL_Point *points, int center_x, int center_y, int radius);
+
+void play_history(SDL_Window *window, SDL_Renderer *renderer, char const *path, bool headless);
+void play_live(SDL_Window *window, SDL_Renderer *renderer, char const *name, bool headless);
+
+int main(int argc, char **argv) {
+	// nn_video [recording] or nn_video --live [shared memory name]
+	bool live = argc > 1 && strcmp(argv[1], VIDEO_LIVE_FLAG) == 0;
+	char const *source = live ?
+		(argc > 2 ? argv[2] : TELEMETRY_DEFAULT_NAME) :
+		(argc > 1 ? argv[1] : HISTORY_DEFAULT_PATH);
 
-int main(void) {
 	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
 		fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
 		return EXIT_FAILURE;
 	}
 
+	// with SDL_VIDEODRIVER=dummy playback runs unthrottled and exits at the end
+	char const *driver = SDL_GetCurrentVideoDriver();
+	bool headless = driver != NULL && strcmp(driver, VIDEO_HEADLESS_DRIVER) == 0;
+
 	struct SDL_Window *window = SDL_CreateWindow(
 		"Neural Networks",
 		0,
@@ -61,31 +124,23 @@ int main(void) {
 		SDL_WINDOW_UTILITY
 	);
 
-	struct SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	struct SDL_Renderer *renderer = SDL_CreateRenderer(
+		window,
+		-1,
+		SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE
+	);
+	if (renderer == NULL) {
+		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+	}
+	assert(renderer != NULL);
 	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-	// struct history_t history = history_new("dist/sample.aiv", HISTORY_READ);
-	// struct network_t network = network_from_history(&history);
-
-	// enum history_token_t token = history_read_token(&network.history);
-
-	// while (token != HISTORY_EOF) {
-	// 	SDL_Event event;
-	// 	listen(&event);
-	// 	if (event.type == SDL_QUIT) {
-	// 		break;
-	// 	}
-
-	// 	network_read_frame(&network, &token);
-	// 	render(window, renderer, &network);
-	// 	// network_print(&network);
-
-	// 	token = history_read_token(&network.history);
-	// 	SDL_Delay(1000 / 15);
-	// }
+	if (live) {
+		play_live(window, renderer, source, headless);
+	} else {
+		play_history(window, renderer, source, headless);
+	}
 
-	// network_free(&network);
-	
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
@@ -93,63 +148,406 @@ int main(void) {
 	return 0;
 }
 
-void listen(SDL_Event *event) {
+void play_history(SDL_Window *window, SDL_Renderer *renderer, char const *path, bool headless) {
+	struct history_t history = history_new(path, O_RDONLY);
+	struct network_t network = history_read_cfg(&history);
+	struct video_t video = video_new(&network);
+
+	bool running = history_read_frame(&history, &network);
+	if (running) {
+		video_push_frame(&video, &network);
+		video_push_frame(&video, &network);
+	}
+
+	integer_t frames_per_step = VIDEO_FRAME_RATE / VIDEO_HISTORY_RATE;
+	integer_t frame_count = 0;
+	bool ended = false;
+	Uint64 start = SDL_GetTicks64();
+
+	while (running) {
+		SDL_Event event;
+		if (listen(&event)) break;
+
+		Uint64 frame_start = SDL_GetTicks64();
+
+		integer_t step = frame_count % frames_per_step;
+		if (step == 0 && frame_count > 0 && !ended) {
+			ended = !history_read_frame(&history, &network);
+
+			if (!ended) {
+				video_push_frame(&video, &network);
+			} else if (headless) {
+				break;
+			} else {
+				// hold the last frame until the window is closed
+				memcpy(video.from, video.to, video.edge_count * sizeof(decimal_t));
+			}
+		}
+
+		render(window, renderer, &network, &video, (decimal_t) step / frames_per_step);
+		frame_count += 1;
+
+		if (headless) continue;
+
+		Uint64 elapsed = SDL_GetTicks64() - frame_start;
+		if (elapsed < 1000 / VIDEO_FRAME_RATE) {
+			SDL_Delay(1000 / VIDEO_FRAME_RATE - elapsed);
+		}
+	}
+
+	Uint64 duration = SDL_GetTicks64() - start;
+	fprintf(
+		stderr,
+		"frames: %u, history frames: %u, fps: %.1lf\n",
+		frame_count,
+		history.size,
+		duration > 0 ? frame_count * 1000.0 / duration : 0.0
+	);
+
+	video_free(&video);
+	network_free(&network);
+	history_close(&history);
+}
+
+void play_live(SDL_Window *window, SDL_Renderer *renderer, char const *name, bool headless) {
+	struct telemetry_t telemetry = telemetry_attach(name);
+	struct network_t network = telemetry_read_cfg(&telemetry);
+	struct video_t video = video_new(&network);
+
+	uint64_t epoch = 0;
+	decimal_t cost = 0;
+	integer_t frame_count = 0;
+	integer_t update_count = 0;
+	Uint64 start = SDL_GetTicks64();
+	Uint64 last_update = start;
+
+	while (true) {
+		SDL_Event event;
+		if (listen(&event)) break;
+
+		Uint64 frame_start = SDL_GetTicks64();
+
+		// only the newest frame matters, everything in between is skipped
+		if (telemetry_read_frame(&telemetry, &network, &epoch, &cost)) {
+			video_push_frame(&video, &network);
+			update_count += 1;
+			last_update = frame_start;
+
+			char title[128];
+			snprintf(title, sizeof(title), "Neural Networks - epoch: %lu, cost: %lf", epoch, cost);
+			SDL_SetWindowTitle(window, title);
+		} else if (headless && frame_start - last_update > VIDEO_LIVE_TIMEOUT) {
+			break;
+		} else if (!telemetry_alive(&telemetry)) {
+			// the trainer is gone, headless viewers are done, the others
+			// keep the last frame up until the next run shows up
+			if (headless) break;
+
+			struct telemetry_t next;
+			if (telemetry_try_attach(name, &next)) {
+				video_free(&video);
+				network_free(&network);
+				telemetry_close(&telemetry);
+
+				telemetry = next;
+				network = telemetry_read_cfg(&telemetry);
+				video = video_new(&network);
+			}
+		}
+
+		render(window, renderer, &network, &video, 1);
+		frame_count += 1;
+
+		Uint64 elapsed = SDL_GetTicks64() - frame_start;
+		if (elapsed < 1000 / VIDEO_FRAME_RATE) {
+			SDL_Delay(1000 / VIDEO_FRAME_RATE - elapsed);
+		}
+	}
+
+	Uint64 duration = SDL_GetTicks64() - start;
+	fprintf(
+		stderr,
+		"frames: %u, live updates: %u, last epoch: %lu, fps: %.1lf\n",
+		frame_count,
+		update_count,
+		epoch,
+		duration > 0 ? frame_count * 1000.0 / duration : 0.0
+	);
+
+	video_free(&video);
+	network_free(&network);
+	telemetry_close(&telemetry);
+}
+
+bool listen(SDL_Event *event) {
 	while (SDL_PollEvent(event)) {
 		if (event->type == SDL_QUIT) {
-			return;
+			return true;
 		}
 	}
+
+	return false;
 }
 
-void render(
-	struct SDL_Window *window,
-	struct SDL_Renderer *renderer,
-	struct network_t *network
+struct video_t video_new(struct network_t *network) {
+	struct video_t self;
+
+	self.width = 0;
+	self.height = 0;
+	self.neurons = NULL;
+	self.edges = NULL;
+
+	self.band_count = network->layer_count - 1;
+	self.band_offsets = calloc(self.band_count + 1, sizeof(integer_t));
+	self.bands = calloc(self.band_count, sizeof(SDL_Rect));
+	self.dirty = calloc(self.band_count, sizeof(bool));
+	assert(self.band_offsets != NULL && self.bands != NULL && self.dirty != NULL);
+
+	self.edge_count = 0;
+	for (int i = 0; i < self.band_count; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		self.band_offsets[i] = self.edge_count;
+		self.edge_count += weights->cols * weights->rows;
+	}
+	self.band_offsets[self.band_count] = self.edge_count;
+
+	self.vertices = calloc(self.edge_count * 4, sizeof(SDL_Vertex));
+	self.indices = calloc(self.edge_count * 6, sizeof(int));
+	self.colors = calloc(self.edge_count, sizeof(Uint32));
+	self.from = calloc(self.edge_count, sizeof(decimal_t));
+	self.to = calloc(self.edge_count, sizeof(decimal_t));
+	assert(self.vertices != NULL && self.indices != NULL && self.colors != NULL);
+	assert(self.from != NULL && self.to != NULL);
+
+	for (int i = 0; i < self.edge_count; i++) {
+		int quad[6] = {0, 1, 2, 2, 1, 3};
+		for (int j = 0; j < 6; j++) {
+			self.indices[i * 6 + j] = i * 4 + quad[j];
+		}
+	}
+
+	return self;
+}
+
+void video_layout(
+	struct video_t *video,
+	SDL_Renderer *renderer,
+	struct network_t *network,
+	int width,
+	int height
 ) {
-	SDL_SetRenderDrawColor(renderer, SDL_ColorHexToArgs(COLOR_BACKGROUND), 0xFF);
+	int screen_length = width > height ? width : height;
+	int neuron_h_distance = width / (1 + network->layer_count);
+
+	SDL_DestroyTexture(video->neurons);
+	SDL_DestroyTexture(video->edges);
+
+	video->width = width;
+	video->height = height;
+	video->neurons = SDL_CreateTexture(
+		renderer,
+		SDL_PIXELFORMAT_RGBA8888,
+		SDL_TEXTUREACCESS_TARGET,
+		width,
+		height
+	);
+	video->edges = SDL_CreateTexture(
+		renderer,
+		SDL_PIXELFORMAT_RGBA8888,
+		SDL_TEXTUREACCESS_TARGET,
+		width,
+		height
+	);
+	assert(video->neurons != NULL && video->edges != NULL);
+	SDL_SetTextureBlendMode(video->neurons, SDL_BLENDMODE_BLEND);
+	SDL_SetTextureBlendMode(video->edges, SDL_BLENDMODE_BLEND);
+
+	// nothing is ever drawn outside the bands, clear it once
+	SDL_SetRenderTarget(renderer, video->edges);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
 	SDL_RenderClear(renderer);
+	SDL_SetRenderTarget(renderer, NULL);
 
-	int screen_size[2];
-	SDL_GetWindowSize(window, screen_size + 0, screen_size + 1);
-	int screen_length = screen_size[0] > screen_size[1] ? screen_size[0] : screen_size[1];
+	integer_t point_count = 0;
+	for (int i = 0; i < network->layer_count; i++) {
+		int layer_size = network->activations[NETWORK_ORIGINAL][i].cols;
+		int radius = (screen_length * 0.2) / (layer_size + 2);
+		point_count += layer_size * 8 * (radius + 1);
+	}
 
+	SDL_Point *points = calloc(point_count, sizeof(SDL_Point));
+	assert(points != NULL);
 
-	int neuron_h_distance = screen_size[0] / (1 + network->layer_count);
+	// every circle goes into the cached texture with a single draw call
+	point_count = 0;
+	integer_t edge_index = 0;
 	for (int i = 0; i < network->layer_count; i++) {
 		int layer_size = network->activations[NETWORK_ORIGINAL][i].cols;
 		int x = neuron_h_distance * (i + 1);
 		int radius = (screen_length * 0.2) / (layer_size + 2);
+		int neuron_v_distance = height / (1 + layer_size);
 
-		int neuron_v_distance = screen_size[1] / (1 + layer_size);
-
-		SDL_SetRenderDrawColor(renderer, SDL_ColorHexToArgs(COLOR_FOREGROUND), 0xFF);
 		for (int j = 0; j < layer_size; j++) {
 			int y = neuron_v_distance * (j + 1);
-			SDL_RenderDrawCircle(renderer, x, y, radius);
+			point_count += SDL_CircleToPoints(points + point_count, x, y, radius);
 		}
 
 		if (i == network->layer_count - 1) continue;
 		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
 
+		video->bands[i] = (SDL_Rect) {x, 0, neuron_h_distance, height};
+		video->dirty[i] = true;
+
+		int next_layer_size = network->activations[NETWORK_ORIGINAL][i + 1].cols;
 		int weights_count = weights->cols * weights->rows;
-		int neuron_v_distance_next = screen_size[1] / (1 + weights->cols);
-		int radius_next = (screen_length * 0.2) / (weights->cols + 2);
-		for (int j = 0; j < weights_count; j++) {
+		int neuron_v_distance_next = height / (1 + next_layer_size);
+		int radius_next = (screen_length * 0.2) / (next_layer_size + 2);
+		for (int j = 0; j < weights_count; j++, edge_index++) {
 			int col = j % weights->cols;
 			int row = j / weights->cols;
-			int ix = neuron_h_distance * (i + 1) + radius;
-			int iy = neuron_v_distance * (row + 1);
-			int ox = neuron_h_distance * (i + 2) - radius_next;
-			int oy = neuron_v_distance_next * (col + 1);
+			int input = network->layout == NETWORK_LAYOUT_IN_OUT ? row : col;
+			int output = network->layout == NETWORK_LAYOUT_IN_OUT ? col : row;
+			float ix = neuron_h_distance * (i + 1) + radius;
+			float iy = neuron_v_distance * (input + 1);
+			float ox = neuron_h_distance * (i + 2) - radius_next;
+			float oy = neuron_v_distance_next * (output + 1);
+
+			// widen the line into a quad along its normal
+			float length = sqrtf((ox - ix) * (ox - ix) + (oy - iy) * (oy - iy));
+			float nx = length > 0 ? -(oy - iy) / length * VIDEO_EDGE_WIDTH / 2 : 0;
+			float ny = length > 0 ? (ox - ix) / length * VIDEO_EDGE_WIDTH / 2 : 0;
+
+			SDL_Vertex *quad = video->vertices + edge_index * 4;
+			quad[0].position = (SDL_FPoint) {ix + nx, iy + ny};
+			quad[1].position = (SDL_FPoint) {ix - nx, iy - ny};
+			quad[2].position = (SDL_FPoint) {ox + nx, oy + ny};
+			quad[3].position = (SDL_FPoint) {ox - nx, oy - ny};
+		}
+	}
+
+	SDL_SetRenderTarget(renderer, video->neurons);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+	SDL_RenderClear(renderer);
+	SDL_SetRenderDrawColor(renderer, SDL_ColorHexToArgs(COLOR_FOREGROUND), 0xFF);
+	SDL_RenderDrawPoints(renderer, points, point_count);
+	SDL_SetRenderTarget(renderer, NULL);
+
+	free(points);
+
+	// force every edge color to be rewritten
+	memset(video->colors, 0, video->edge_count * sizeof(Uint32));
+}
+
+void video_push_frame(struct video_t *video, struct network_t *network) {
+	decimal_t *swap = video->from;
+	video->from = video->to;
+	video->to = swap;
+
+	integer_t edge_index = 0;
+	for (int i = 0; i < network->layer_count - 1; i++) {
+		struct matrix_t *weights = network->weights[NETWORK_ORIGINAL] + i;
+		integer_t weights_count = weights->cols * weights->rows;
+
+		memcpy(video->to + edge_index, weights->items, weights_count * sizeof(decimal_t));
+		edge_index += weights_count;
+	}
+}
+
+integer_t video_update(struct video_t *video, decimal_t progress) {
+	integer_t changed_count = 0;
+
+	integer_t band = 0;
+	for (int i = 0; i < video->edge_count; i++) {
+		while (i >= video->band_offsets[band + 1]) band += 1;
+
+		decimal_t weight = video->from[i] + (video->to[i] - video->from[i]) * progress;
+
+		// negative weights red, positive blue, stronger is more opaque
+		decimal_t strength = tanh(weight);
+		Uint32 hex = strength < 0 ? COLOR_RED : COLOR_BLUE;
+		Uint8 alpha = VIDEO_EDGE_MIN_ALPHA + (0xFF - VIDEO_EDGE_MIN_ALPHA) * fabs(strength);
+		Uint32 color = (hex << 8) | alpha;
+
+		if (video->colors[i] == color) continue;
+		video->colors[i] = color;
+		video->dirty[band] = true;
+		changed_count += 1;
 
-			SDL_RenderDrawLine(renderer, ix, iy, ox, oy);
+		SDL_Color vertex_color = {SDL_ColorHexToArgs(hex), alpha};
+		for (int j = 0; j < 4; j++) {
+			video->vertices[i * 4 + j].color = vertex_color;
 		}
 	}
 
+	return changed_count;
+}
+
+void video_free(struct video_t *video) {
+	SDL_DestroyTexture(video->neurons);
+	SDL_DestroyTexture(video->edges);
+
+	free(video->vertices);
+	free(video->indices);
+	free(video->colors);
+	free(video->band_offsets);
+	free(video->bands);
+	free(video->dirty);
+	free(video->from);
+	free(video->to);
+}
+
+void render(
+	struct SDL_Window *window,
+	struct SDL_Renderer *renderer,
+	struct network_t *network,
+	struct video_t *video,
+	decimal_t progress
+) {
+	int screen_size[2];
+	SDL_GetWindowSize(window, screen_size + 0, screen_size + 1);
+
+	if (screen_size[0] != video->width || screen_size[1] != video->height) {
+		video_layout(video, renderer, network, screen_size[0], screen_size[1]);
+	}
+
+	video_update(video, progress);
+
+	// only bands where at least one edge changed color are wiped and
+	// redrawn, one geometry call each, clipped so no band bleeds into
+	// its neighbour when edges are wider than the neuron gap
+	SDL_SetRenderTarget(renderer, video->edges);
+	for (int i = 0; i < video->band_count; i++) {
+		if (!video->dirty[i]) continue;
+
+		integer_t first = video->band_offsets[i];
+		integer_t length = video->band_offsets[i + 1] - first;
+
+		SDL_RenderSetClipRect(renderer, video->bands + i);
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+		SDL_RenderFillRect(renderer, video->bands + i);
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+		SDL_RenderGeometry(
+			renderer,
+			NULL,
+			video->vertices,
+			video->edge_count * 4,
+			video->indices + first * 6,
+			length * 6
+		);
+		video->dirty[i] = false;
+	}
+	SDL_RenderSetClipRect(renderer, NULL);
+	SDL_SetRenderTarget(renderer, NULL);
+
+	SDL_SetRenderDrawColor(renderer, SDL_ColorHexToArgs(COLOR_BACKGROUND), 0xFF);
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, video->edges, NULL, NULL);
+	SDL_RenderCopy(renderer, video->neurons, NULL, NULL);
 	SDL_RenderPresent(renderer);
 }
 
-void SDL_RenderDrawCircle(SDL_Renderer *renderer, int center_x, int center_y, int radius) {
+int SDL_CircleToPoints(SDL_Point *points, int center_x, int center_y, int radius) {
 	int diameter = (radius * 2);
 
 	int x = radius - 1;
@@ -159,16 +557,17 @@ void SDL_RenderDrawCircle(SDL_Renderer *renderer, int center_x, int center_y, in
 	int t_y = 1;
 
 	int error = t_x - diameter;
+	int count = 0;
 
 	while (x >= y) {
-		SDL_RenderDrawPoint(renderer, center_x + x, center_y - y);
-		SDL_RenderDrawPoint(renderer, center_x + x, center_y + y);
-		SDL_RenderDrawPoint(renderer, center_x - x, center_y - y);
-		SDL_RenderDrawPoint(renderer, center_x - x, center_y + y);
-		SDL_RenderDrawPoint(renderer, center_x + y, center_y - x);
-		SDL_RenderDrawPoint(renderer, center_x + y, center_y + x);
-		SDL_RenderDrawPoint(renderer, center_x - y, center_y - x);
-		SDL_RenderDrawPoint(renderer, center_x - y, center_y + x);
+		points[count++] = (SDL_Point) {center_x + x, center_y - y};
+		points[count++] = (SDL_Point) {center_x + x, center_y + y};
+		points[count++] = (SDL_Point) {center_x - x, center_y - y};
+		points[count++] = (SDL_Point) {center_x - x, center_y + y};
+		points[count++] = (SDL_Point) {center_x + y, center_y - x};
+		points[count++] = (SDL_Point) {center_x + y, center_y + x};
+		points[count++] = (SDL_Point) {center_x - y, center_y - x};
+		points[count++] = (SDL_Point) {center_x - y, center_y + x};
 
 		if (error <= 0) {
 			y += 1;
@@ -182,4 +581,6 @@ void SDL_RenderDrawCircle(SDL_Renderer *renderer, int center_x, int center_y, in
 			error += t_x - diameter;
 		}
 	}
+
+	return count;
 }